@@ -1,17 +1,64 @@
 #include "qs.hpp"
+#include <cmath>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 
-template<typename T>
-T soft_thresholding(T x, float lambda, float tau)
+// minimize 1/2 ‖Ax − b‖^2 + \lambda ‖x‖^1 by ADMM, returns the objective.
+// With qs::SolverTrace every iteration records phase timings and residuals,
+// with qs::NullObserver that work compiles out.
+template<typename O>
+float admm(const qs::Matrixf<3, 3>& A, const qs::Vectorf<3>& b, qs::Vectorf<3>& x, O& obs)
 {
-    T out(x.row(), x.col(), x.array().sign() * (x.array().abs() - (lambda * tau)).max(0));
-    return out;
+    auto lambda{0.5f};
+    auto tau_inv{0.001f};
+    qs::Matrixf<3, 3> AtA_tauI_inv;
+    qs::Vectorf<3> Atb;
+    {
+        qs::PhaseScope<O> scope(obs, qs::Phase::factor);
+        auto AtA_tauI{A.t() * A + tau_inv * qs::DiagonalMatrix<float>::identity(3)};
+        AtA_tauI_inv = AtA_tauI.inv();
+        Atb = A.t() * b;
+    }
+
+    auto z = x.rand();
+    auto y = x.rand();
+    qs::Vectorf<3> last_z;
+
+    auto last_fx{(A * x - b).norm2() + lambda * x.norm1()};
+    while (1) {
+        {
+            qs::PhaseScope<O> scope(obs, qs::Phase::solve);
+            x = AtA_tauI_inv * (Atb + tau_inv * (z - y));
+        }
+        {
+            qs::PhaseScope<O> scope(obs, qs::Phase::prox);
+            if constexpr (O::enabled) last_z = z;
+            z = x + y;
+            qs::prox::soft_threshold_(z, lambda / tau_inv);
+            y = y + tau_inv * (x - z);
+        }
+        bool converged;
+        float fx;
+        {
+            qs::PhaseScope<O> scope(obs, qs::Phase::check);
+            fx = (A * x - b).norm2() + lambda * x.norm1();
+            converged = std::abs(fx - last_fx) < 1.0e-6;
+        }
+        if constexpr (O::enabled) {
+            // primal ‖x − z‖, dual \tau^-1 ‖z − z_prev‖
+            obs.iteration(fx, (x - z).norm2(), tau_inv * (z - last_z).norm2());
+        }
+        if (converged) {
+            break;
+        }
+        last_fx = fx;
+    }
+    return last_fx;
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    // minimize 1/2 ‖Ax − b‖^2 + \lambda ‖x‖^1
     qs::Matrixf<3, 3> A;
     qs::Vectorf<3> x;
     qs::Vectorf<3> b;
@@ -25,30 +72,22 @@ int main()
     std::cout << "b: " << b << "\n";
     std::cout << "init x: " << x << "\n";
 
-    auto lambda{0.5f};
-    auto tau_inv{0.001f};
-    auto AtA_tauI{A.t() * A + tau_inv * qs::Matrixf<3, 3>::eye()};
-    auto AtA_tauI_inv{AtA_tauI.inv()};
-    auto Atb{A.t() * b};
-
-    auto z = x.rand();
-    auto y = x.rand();
+    qs::SolverTrace trace;
+    auto fx{admm(A, b, x, trace)};
 
-    auto last_fx{(A * x - b).norm2() + lambda * x.norm1()};
-    while (1) {
-        x = AtA_tauI_inv * (Atb + tau_inv * (z - y));
-        z = soft_thresholding(x + y, lambda, 1.0 / tau_inv);
-        y = y + tau_inv * (x - z);
-
-        auto fx{(A * x - b).norm2() + lambda * x.norm1()};
-        if (std::abs(fx - last_fx) < 1.0e-6) {
-            break;
-        }
-        last_fx = fx;
+    std::cout << "fx: " << fx << "\n";
+    std::cout << "result : " << x << "\n";
+    std::cout << "iterations: " << trace.size() << "\n";
+    if (argc > 1) {
+        std::ofstream csv(argv[1]);
+        trace.write_csv(csv);
     }
 
-    std::cout << "fx: " << last_fx << "\n";
-    std::cout << "result : " << x << "\n";
+    // the same solve without observation
+    qs::Vectorf<3> x0;
+    x0 << 4.0, 6.0, 9.0;
+    qs::NullObserver none;
+    std::cout << "untraced fx: " << admm(A, b, x0, none) << "\n";
 
     return 0;
 }
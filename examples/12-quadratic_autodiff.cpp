@@ -0,0 +1,48 @@
+#include "qs.hpp"
+#include <cstdlib>
+#include <iostream>
+
+
+int main()
+{
+    // f(x) = x^TAx, Newton-CG with gradient and Hessian-vector products from the tape
+    qs::Matrixf<3, 3> A;
+    qs::Vectorf<3> x;
+    A << 8, 2, 3,
+         2, 9, 5,
+         3, 5, 6;
+    x << 4.0, 6.0, 9.0;
+    std::cout << A << "\n";
+    std::cout << "init x: " << x << "\n";
+
+    auto f{[&] (const auto& x) { return x.t() * A * x; }};
+    qs::ad::Tape<float> tape(true);
+    qs::MatrixXf J(3, 1);
+    float last_val{tape.gradient(f, x, J)};
+    while (1) {
+        // solve H * theta = -J with conjugate gradient
+        qs::MatrixXf theta(3, 1);
+        qs::MatrixXf r{J * -1.0f};
+        qs::MatrixXf p{r};
+        auto rr{(r.t() * r).scalar()};
+        for (int i = 0; i < x.size() && rr > 1.0e-12f; ++i) {
+            auto Hp{tape.hvp(f, x, p)};
+            auto alpha{rr / (p.t() * Hp).scalar()};
+            theta = theta + p * alpha;
+            r = r - Hp * alpha;
+            auto rr_new{(r.t() * r).scalar()};
+            p = r + p * (rr_new / rr);
+            rr = rr_new;
+        }
+
+        x = (x + theta);
+        float this_val{tape.gradient(f, x, J)};
+        if (std::abs(last_val - this_val) < 1.0e-5) {
+            break;
+        }
+        last_val = this_val;
+    }
+    std::cout << "=============\nresult: " << x << "\n";
+
+    return 0;
+}
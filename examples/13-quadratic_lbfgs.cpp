@@ -0,0 +1,30 @@
+#include "qs.hpp"
+#include <cstdlib>
+#include <iostream>
+
+
+int main()
+{
+    // f(x) = x^TAx
+    qs::Matrixf<3, 3> A;
+    qs::MatrixXf x(3, 1);
+    A << 8, 2, 3,
+         2, 9, 5,
+         3, 5, 6;
+    x << 4.0, 6.0, 9.0;
+    std::cout << A << "\n";
+    std::cout << "init x: " << x << "\n";
+
+    auto AAt{A + A.t()};
+    qs::optim::Options<float> opt;
+    opt.grad_tol = 1.0e-4f;
+    qs::optim::LBFGS<float> solver(x.size(), opt);
+    auto result{solver.minimize([&] (const qs::MatrixXf& x, qs::MatrixXf& g) {
+        g = AAt * x;
+        return (x.t() * A * x).scalar();
+    }, x)};
+    std::cout << "=============\niterations: " << result.iter << ", evaluations: " << result.evals << "\n";
+    std::cout << "result: " << x << "\n";
+
+    return 0;
+}
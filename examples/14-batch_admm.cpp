@@ -0,0 +1,57 @@
+#include "qs.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+int main()
+{
+    // a batch of independent lasso problems of different sizes,
+    // minimize 1/2 ‖Ax − b‖^2 + \lambda ‖x‖^1 for each
+    const int batch{64};
+    std::vector<float> fx(batch);
+    std::vector<int> iters(batch);
+
+    qs::SolveOptions opt;
+    opt.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    opt.task_budget = std::chrono::milliseconds(500);
+
+    auto result{qs::parallel_solve(batch, [&] (int i, const qs::SolveContext& ctx) {
+        const int n{2 + i % 7};
+        qs::MatrixXf A(2 * n, n);
+        qs::MatrixXf b(2 * n, 1);
+        A.fill_normal_(0.f, 1.f, qs::Philox(42, 2 * i));
+        b.fill_normal_(0.f, 1.f, qs::Philox(42, 2 * i + 1));
+
+        const auto lambda{0.1f};
+        const auto tau_inv{1.f};
+        auto AtA_tauI_inv{(A.t() * A + tau_inv * qs::DiagonalMatrix<float>::identity(n)).inv()};
+        auto Atb{A.t() * b};
+        qs::MatrixXf x(n, 1), z(n, 1), y(n, 1);
+        x.fill_0_();
+        z.fill_0_();
+        y.fill_0_();
+
+        auto last_fx{(A * x - b).norm2() + lambda * x.norm1()};
+        int k{0};
+        for (; !ctx.stop_requested(); ++k) {
+            x = AtA_tauI_inv * (Atb + tau_inv * (z - y));
+            z = x + y;
+            qs::prox::soft_threshold_(z, lambda / tau_inv);
+            y = y + (x - z);
+
+            auto f{(A * x - b).norm2() + lambda * x.norm1()};
+            if (std::abs(f - last_fx) < 1.0e-6f) break;
+            last_fx = f;
+        }
+        fx[i] = last_fx;
+        iters[i] = k;
+    }, opt)};
+
+    std::cout << "solved: " << result.done << ", skipped: " << result.skipped << "\n";
+    for (int i = 0; i < 4; ++i) {
+        std::cout << "problem " << i << " fx: " << fx[i] << " iterations: " << iters[i] << "\n";
+    }
+
+    return 0;
+}
@@ -1,769 +1,5797 @@
 #ifndef QS_HPP_
 #define QS_HPP_
 
-#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <vector>
 #include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <ostream>
+#include <thread>
+#include <string>
+#include <type_traits>
+#include <utility>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
 
 #define QS_PRINT_PRECISION 2
 
+// Checked mode adds bounds, shape and aliasing checks to element access and
+// to the kernels, without it everything runs on unchecked raw pointers.
+// It follows NDEBUG unless QS_CHECKED is defined to 0 or 1.
+#ifndef QS_CHECKED
+#ifdef NDEBUG
+#define QS_CHECKED 0
+#else
+#define QS_CHECKED 1
+#endif
+#endif
+
+#if QS_CHECKED
+#define QS_ASSERT(cond) ((cond) ? static_cast<void>(0) : ::qs::detail::check_failed(#cond, __FILE__, __LINE__))
+#define QS_ASSERT_NO_ALIAS(a, na, b, nb) QS_ASSERT(!::qs::detail::overlaps((a), (na), (b), (nb)))
+#else
+#define QS_ASSERT(cond) static_cast<void>(sizeof(!(cond)))
+#define QS_ASSERT_NO_ALIAS(a, na, b, nb) static_cast<void>(sizeof((a), (na), (b), (nb)))
+#endif
+
+// Always on, for misuse that would corrupt memory even in release builds
+#define QS_VERIFY(cond) ((cond) ? static_cast<void>(0) : ::qs::detail::check_failed(#cond, __FILE__, __LINE__))
+
 namespace qs {
 
-template<typename T, int R, int C>
-struct Matrix;
+namespace detail {
+
+[[noreturn]] inline void check_failed(const char* cond, const char* file, int line)
+{
+    std::cerr << file << ":" << line << ": qs check failed: " << cond << "\n";
+    std::abort();
+}
+
+template<typename A, typename B>
+bool overlaps(const A* a, std::int64_t na, const B* b, std::int64_t nb)
+{
+    const auto a0{reinterpret_cast<std::uintptr_t>(a)};
+    const auto b0{reinterpret_cast<std::uintptr_t>(b)};
+    return a0 < b0 + nb * sizeof(B) && b0 < a0 + na * sizeof(A);
+}
+
+} // namespace detail
+
+inline std::atomic<int>& num_threads_()
+{
+    static std::atomic<int> n{static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))};
+    return n;
+}
+
+// per thread override of num_threads(), 0 when unset
+inline int& thread_num_threads_()
+{
+    thread_local int n{0};
+    return n;
+}
+
+namespace detail {
+
+// Caps num_threads() on the calling thread for the lifetime of the guard
+struct ThreadCap
+{
+    explicit ThreadCap(int n) : saved_(thread_num_threads_()) { thread_num_threads_() = n; }
+    ~ThreadCap() { thread_num_threads_() = saved_; }
+    ThreadCap(const ThreadCap&) = delete;
+    ThreadCap& operator=(const ThreadCap&) = delete;
+private:
+    int saved_;
+}; // struct ThreadCap
+
+} // namespace detail
+
+inline int num_threads()
+{
+    const auto local{thread_num_threads_()};
+    return local > 0 ? local : num_threads_().load(std::memory_order_relaxed);
+}
+inline void set_num_threads(int n) { QS_ASSERT(n > 0); num_threads_().store(n, std::memory_order_relaxed); }
+
+inline std::atomic<bool>& pin_threads_()
+{
+    static std::atomic<bool> pin{false};
+    return pin;
+}
+
+// With pinning on, parallel_for worker i always runs on the same CPU of the
+// process affinity mask, spread evenly over the mask for num_threads()
+// workers. Equal splits then land on equal CPUs from call to call, which
+// is what makes the first touch of AllocPolicy::parallel_touch_bytes NUMA
+// local. Linux only, elsewhere it has no effect.
+inline bool pin_threads() { return pin_threads_().load(std::memory_order_relaxed); }
+inline void set_pin_threads(bool pin) { pin_threads_().store(pin, std::memory_order_relaxed); }
+
+namespace detail {
+
+#if defined(__linux__)
+// CPUs of the process affinity mask when first asked
+inline const std::vector<int>& affinity_cpus()
+{
+    static const std::vector<int> cpus{[] {
+        std::vector<int> v;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int c = 0; c < CPU_SETSIZE; ++c) {
+                if (CPU_ISSET(c, &set)) v.push_back(c);
+            }
+        }
+        return v;
+    }()};
+    return cpus;
+}
+#endif
+
+// binds the calling thread to the CPU of parallel_for worker i out of
+// `workers`
+inline void pin_worker(int i, int workers)
+{
+#if defined(__linux__)
+    const auto& cpus{affinity_cpus()};
+    if (cpus.empty()) return;
+    const auto size{static_cast<std::int64_t>(cpus.size())};
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[static_cast<std::size_t>(i * size / workers % size)], &set);
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+#else
+    static_cast<void>(i);
+    static_cast<void>(workers);
+#endif
+}
+
+} // namespace detail
+
+// Split [0, n) into at most num_threads() contiguous ranges of at least
+// `grain` items and run fn(begin, end) on each, the calling thread takes
+// the last range. Worker threads are pinned when pin_threads() is on.
+template<typename F>
+void parallel_for(int n, int grain, F&& fn)
+{
+    const auto threads{num_threads()};
+    const auto chunks{std::min(threads, std::max(1, n / std::max(1, grain)))};
+    if (chunks <= 1) {
+        if (n > 0) fn(0, n);
+        return;
+    }
+
+    const auto pin{pin_threads()};
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+    for (int i = 0; i < chunks - 1; ++i) {
+        const int begin{static_cast<int>(static_cast<std::int64_t>(n) * i / chunks)};
+        const int end{static_cast<int>(static_cast<std::int64_t>(n) * (i + 1) / chunks)};
+        workers.emplace_back([&fn, begin, end, pin, i, threads] {
+            if (pin) detail::pin_worker(i, threads);
+            fn(begin, end);
+        });
+    }
+    fn(static_cast<int>(static_cast<std::int64_t>(n) * (chunks - 1) / chunks), n);
+    for (auto& w : workers) w.join();
+}
+
+namespace detail {
+
+// IEEE binary16 <-> binary32, round to nearest even, keeps subnormals,
+// infinities and NaNs
+inline float fp16_to_float(std::uint16_t h)
+{
+#if defined(__F16C__)
+    return _cvtsh_ss(h);
+#else
+    const std::uint32_t sign{static_cast<std::uint32_t>(h & 0x8000) << 16};
+    std::uint32_t exp{(h >> 10) & 0x1fu};
+    std::uint32_t mant{h & 0x3ffu};
+    std::uint32_t bits;
+    if (exp == 0x1f) {
+        bits = sign | 0x7f800000u | (mant << 13);
+    } else if (exp != 0) {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {
+        bits = sign;
+    } else {
+        // subnormal, normalize
+        exp = 113;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            --exp;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+#endif
+}
+
+inline std::uint16_t float_to_fp16(float f)
+{
+#if defined(__F16C__)
+    return _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+#else
+    std::uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const auto sign{static_cast<std::uint16_t>((bits >> 16) & 0x8000)};
+    const std::uint32_t abs{bits & 0x7fffffffu};
+    if (abs > 0x7f800000u) return sign | 0x7e00 | static_cast<std::uint16_t>((abs >> 13) & 0x3ff);
+    if (abs >= 0x477ff000u) return sign | 0x7c00;
+    if (abs < 0x38800000u) {
+        // subnormal or zero in half precision, align the mantissa to 2^-24
+        if (abs < 0x33000000u) return sign;
+        const std::uint32_t exp{abs >> 23};
+        const std::uint32_t mant{(abs & 0x7fffff) | 0x800000};
+        const std::uint32_t shift{126 - exp};
+        const std::uint32_t half{1u << (shift - 1)};
+        const std::uint32_t rest{mant & ((1u << shift) - 1)};
+        std::uint32_t h{mant >> shift};
+        if (rest > half || (rest == half && (h & 1))) ++h;
+        return sign | static_cast<std::uint16_t>(h);
+    }
+    // normal, the carry of the rounding may move into the exponent
+    const std::uint32_t rounded{abs + 0xfff + ((abs >> 13) & 1)};
+    return sign | static_cast<std::uint16_t>((rounded - 0x38000000u) >> 13);
+#endif
+}
+
+inline float bf16_to_float(std::uint16_t h)
+{
+    const std::uint32_t bits{static_cast<std::uint32_t>(h) << 16};
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline std::uint16_t float_to_bf16(float f)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) return static_cast<std::uint16_t>((bits >> 16) | 0x40);
+    return static_cast<std::uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+}
+
+struct Fp16Format
+{
+    static float to_float(std::uint16_t h) { return fp16_to_float(h); }
+    static std::uint16_t from_float(float f) { return float_to_fp16(f); }
+}; // struct Fp16Format
+
+struct Bf16Format
+{
+    static float to_float(std::uint16_t h) { return bf16_to_float(h); }
+    static std::uint16_t from_float(float f) { return float_to_bf16(f); }
+}; // struct Bf16Format
+
+} // namespace detail
+
+// 16 bit floating point storage type. Values convert to float for every
+// operation, so arithmetic and accumulation happen in float and only the
+// stored result is rounded (to nearest even). fp16 is IEEE binary16, bf16
+// keeps the float exponent range with an 8 bit mantissa.
+template<typename Format>
+struct Float16
+{
+    std::uint16_t bits;
+
+    Float16() = default;
+    Float16(float f) : bits(Format::from_float(f)) {}
+    inline operator float() const { return Format::to_float(bits); }
+    static Float16 from_bits(std::uint16_t b) { Float16 h; h.bits = b; return h; }
+
+    inline Float16& operator+=(float v) { return *this = float(*this) + v; }
+    inline Float16& operator-=(float v) { return *this = float(*this) - v; }
+    inline Float16& operator*=(float v) { return *this = float(*this) * v; }
+    inline Float16& operator/=(float v) { return *this = float(*this) / v; }
+    inline Float16 operator-() const { return from_bits(bits ^ 0x8000); }
+}; // struct Float16
+
+using fp16 = Float16<detail::Fp16Format>;
+using bf16 = Float16<detail::Bf16Format>;
 
 template<typename T>
-struct MatrixX;
+struct is_float16 : std::false_type {};
+template<typename F>
+struct is_float16<Float16<F>> : std::true_type {};
+template<typename T>
+inline constexpr bool is_float16_v{is_float16<T>::value};
 
+// type sums and products of T are accumulated in
 template<typename T>
-struct Array
+struct accum { using type = T; };
+template<typename F>
+struct accum<Float16<F>> { using type = float; };
+template<typename T>
+using accum_t = typename accum<T>::type;
+
+namespace detail {
+
+// bulk conversions, F16C and AVX512-BF16 when the build enables them. The
+// vector bf16 rounding (vcvtneps2bf16) flushes float subnormals to zero,
+// the scalar path keeps them.
+inline void to_float(const fp16* src, float* dst, int n)
 {
-    Array(int size);
-    Array(const Array& other);
-    Array(Array&& other);
-    Array& operator=(const Array& other);
-    Array& operator=(Array&& other);
+    int i{0};
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        const auto h{_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))};
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = src[i];
+}
 
-    bool operator==(const Array& other) const;
-    Array operator*(const Array& other) const;
-    Array operator*(T v) const;
-    Array operator+(const Array& other) const;
-    Array operator-(const Array& other) const;
-    Array operator+(T v) const;
-    Array operator-(T v) const;
+inline void from_float(const float* src, fp16* dst, int n)
+{
+    int i{0};
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        const auto h{_mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)};
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+#endif
+    for (; i < n; ++i) dst[i] = src[i];
+}
 
-    inline T at(int i) const { return data_.at(i); };
-    inline T& at(int i) { return data_.at(i); };
-    inline int size() const { return data_.size(); };
+inline void to_float(const bf16* src, float* dst, int n)
+{
+    int i{0};
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+        // the zero masked forms dodge a GCC 12 -Wmaybe-uninitialized false
+        // positive on the unmasked intrinsics
+        const auto h{_mm512_maskz_cvtepu16_epi32(0xffff, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)))};
+        _mm512_storeu_si512(dst + i, _mm512_maskz_slli_epi32(0xffff, h, 16));
+    }
+#elif defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        const auto h{_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)))};
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_slli_epi32(h, 16));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = src[i];
+}
 
-    Array max(T v) const;
-    Array abs() const;
-    Array sign();
-    void max_(T v);
-    void abs_();
-private:
-    friend struct MatrixX<T>;
+inline void from_float(const float* src, bf16* dst, int n)
+{
+    int i{0};
+#if defined(__AVX512BF16__) && defined(__AVX512VL__)
+    for (; i + 16 <= n; i += 16) {
+        const auto h{_mm512_cvtneps_pbh(_mm512_loadu_ps(src + i))};
+        std::memcpy(dst + i, &h, sizeof(h));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = src[i];
+}
 
-    std::vector<T> data_;
-}; // struct Array
+// Float16 kernels work on float chunks of this many elements
+constexpr int half_chunk{256};
+
+// sum a[i] * x[i] in float, eight partial sums so the loop vectorizes
+template<typename F>
+float dot_f32(const Float16<F>* a, const float* x, int n)
+{
+    float buf[half_chunk];
+    float acc[8]{};
+    float result{0};
+    for (int i = 0; i < n; i += half_chunk) {
+        const auto len{std::min(half_chunk, n - i)};
+        to_float(a + i, buf, len);
+        int k{0};
+        for (; k + 8 <= len; k += 8) {
+            for (int r = 0; r < 8; ++r) acc[r] += buf[k + r] * x[i + k + r];
+        }
+        for (; k < len; ++k) result += buf[k] * x[i + k];
+    }
+    for (int r = 0; r < 8; ++r) result += acc[r];
+    return result;
+}
+
+// a[i] = op(a[i], b[i]), Float16 arrays are converted chunkwise and op runs
+// on floats
+template<typename T, typename Op>
+void zip_(T* a, const T* b, int n, Op op)
+{
+    if constexpr (is_float16_v<T>) {
+        float fa[half_chunk], fb[half_chunk];
+        for (int i = 0; i < n; i += half_chunk) {
+            const auto len{std::min(half_chunk, n - i)};
+            to_float(a + i, fa, len);
+            to_float(b + i, fb, len);
+            for (int k = 0; k < len; ++k) fa[k] = op(fa[k], fb[k]);
+            from_float(fa, a + i, len);
+        }
+    } else {
+        for (int i = 0; i < n; ++i) a[i] = op(a[i], b[i]);
+    }
+}
+
+// a[i] = op(a[i])
+template<typename T, typename Op>
+void map_(T* a, int n, Op op)
+{
+    if constexpr (is_float16_v<T>) {
+        float fa[half_chunk];
+        for (int i = 0; i < n; i += half_chunk) {
+            const auto len{std::min(half_chunk, n - i)};
+            to_float(a + i, fa, len);
+            for (int k = 0; k < len; ++k) fa[k] = op(fa[k]);
+            from_float(fa, a + i, len);
+        }
+    } else {
+        for (int i = 0; i < n; ++i) a[i] = op(a[i]);
+    }
+}
+
+// out(i, j) = op(a(i, j), b(i, j)) over an r x c result where an operand
+// with a single row or column is reused along that axis instead of being
+// expanded, rows are split across threads
+template<typename T, typename Op>
+void broadcast(const T* a, int ar, int ac, const T* b, int br, int bc, T* out, int r, int c, Op op)
+{
+    using A = accum_t<T>;
+    parallel_for(r, std::max(1, (1 << 18) / std::max(1, c)), [&] (int r0, int r1) {
+        for (int i = r0; i < r1; ++i) {
+            const T* pa{a + (ar == 1 ? 0 : i * ac)};
+            const T* pb{b + (br == 1 ? 0 : i * bc)};
+            T* po{out + i * c};
+            if (ac == c && bc == c) {
+                for (int j = 0; j < c; ++j) po[j] = op(A(pa[j]), A(pb[j]));
+            } else if (ac == c) {
+                const A v{pb[0]};
+                for (int j = 0; j < c; ++j) po[j] = op(A(pa[j]), v);
+            } else if (bc == c) {
+                const A v{pa[0]};
+                for (int j = 0; j < c; ++j) po[j] = op(v, A(pb[j]));
+            } else {
+                const T v(op(A(pa[0]), A(pb[0])));
+                std::fill(po, po + c, v);
+            }
+        }
+    });
+}
+
+enum class Reduce
+{
+    sum,
+    mean,
+    norm,
+    max,
+};
 
+// Reduce each row (rowwise) or each column of a row-major r x c matrix into
+// out. Rows are split across threads. Columns are reduced by sweeping whole
+// rows into an accumulator row, one per row range, so every pass stays unit
+// stride; the partial rows are combined in range order, which keeps the
+// result independent of thread timing.
 template<typename T>
-struct MatrixX
+void reduce(const T* a, int r, int c, bool rowwise, Reduce kind, T* out)
 {
-protected:
-    struct MatrixInitalizer
+    using A = accum_t<T>;
+    const int n{rowwise ? c : r};
+    QS_ASSERT(n > 0 || (kind != Reduce::max && kind != Reduce::mean));
+    const auto finish{[&] (A v) -> T {
+        if (kind == Reduce::mean) return T(v / static_cast<A>(n));
+        if (kind == Reduce::norm) return T(std::sqrt(v));
+        return T(v);
+    }};
+    const int grain{std::max(1, (1 << 18) / std::max(1, c))};
+    if (rowwise) {
+        parallel_for(r, grain, [&] (int r0, int r1) {
+            for (int i = r0; i < r1; ++i) {
+                const T* pa{a + i * c};
+                A acc{kind == Reduce::max ? A(pa[0]) : A(0)};
+                for (int j = 0; j < c; ++j) {
+                    const A v{pa[j]};
+                    if (kind == Reduce::max) acc = std::max(acc, v);
+                    else if (kind == Reduce::norm) acc += v * v;
+                    else acc += v;
+                }
+                out[i] = finish(acc);
+            }
+        });
+        return;
+    }
+
+    // same split parallel_for would pick, one accumulator row per range
+    const int ranges{std::min(num_threads(), std::max(1, r / grain))};
+    std::vector<A> partial(static_cast<std::size_t>(ranges) * c);
+    parallel_for(ranges, 1, [&] (int g0, int g1) {
+        for (int g = g0; g < g1; ++g) {
+            const int i0{static_cast<int>(static_cast<std::int64_t>(r) * g / ranges)};
+            const int i1{static_cast<int>(static_cast<std::int64_t>(r) * (g + 1) / ranges)};
+            A* acc{partial.data() + static_cast<std::size_t>(g) * c};
+            if (kind == Reduce::max) {
+                for (int j = 0; j < c; ++j) acc[j] = A(a[i0 * c + j]);
+            }
+            for (int i = i0; i < i1; ++i) {
+                const T* pa{a + i * c};
+                if (kind == Reduce::max) {
+                    for (int j = 0; j < c; ++j) acc[j] = std::max(acc[j], A(pa[j]));
+                } else if (kind == Reduce::norm) {
+                    for (int j = 0; j < c; ++j) acc[j] += A(pa[j]) * A(pa[j]);
+                } else {
+                    for (int j = 0; j < c; ++j) acc[j] += A(pa[j]);
+                }
+            }
+        }
+    });
+    for (int g = 1; g < ranges; ++g) {
+        const A* acc{partial.data() + static_cast<std::size_t>(g) * c};
+        for (int j = 0; j < c; ++j) {
+            partial[j] = kind == Reduce::max ? std::max(partial[j], acc[j]) : partial[j] + acc[j];
+        }
+    }
+    for (int j = 0; j < c; ++j) out[j] = finish(partial[j]);
+}
+
+} // namespace detail
+
+// Cooperative stop flag with an optional deadline. A token can be chained to
+// a parent, it then also reports a stop when the parent does. Long running
+// loops poll stop_requested(), see optim::Options::stop and parallel_solve.
+struct StopToken
+{
+    using clock = std::chrono::steady_clock;
+
+    explicit StopToken(clock::time_point deadline = clock::time_point::max(), const StopToken* parent = nullptr)
+        : stop_(false), deadline_(deadline), parent_(parent)
+    {}
+    StopToken(const StopToken&) = delete;
+    StopToken& operator=(const StopToken&) = delete;
+
+    inline void request_stop() { stop_.store(true, std::memory_order_relaxed); }
+    inline clock::time_point deadline() const { return deadline_; }
+    inline bool expired() const { return deadline_ != clock::time_point::max() && clock::now() >= deadline_; }
+    inline bool stop_requested() const
     {
-        MatrixInitalizer(MatrixX* m) : m(m), i(1) {}
-        MatrixInitalizer& operator,(T v);
-        MatrixX* m;
-        int i;
-    }; // struct MatrixInitalizer
+        return stop_.load(std::memory_order_relaxed) || expired() || (parent_ && parent_->stop_requested());
+    }
+private:
+    std::atomic<bool> stop_;
+    clock::time_point deadline_;
+    const StopToken* parent_;
+}; // struct StopToken
 
-    Array<T> array_;
-    int col_;
-    int row_;
+enum class Phase
+{
+    factor,
+    solve,
+    prox,
+    line_search,
+    check,
+    count_,
+}; // enum class Phase
 
-    void eye_();
-public:
-    static MatrixX<T> eye(int row_col);
-    inline int row() const { return row_; };
-    inline int col() const { return col_; };
-    inline int size() const { return array_.size(); };
-    inline T& at(int i) { return array_.at(i); };
-    inline T at(int i) const { return array_.at(i); };
-    inline T& at(int r, int c) { return at(r * col() + c); };
-    inline T at(int r, int c) const { return at(r * col() + c); };
-    inline T scalar() const { assert(is_scalar()); return array_.at(0); }
-    inline bool is_scalar() const { return size() == 1; }
-    inline const std::vector<T>& data() const { return array_.data_; }
-    inline const Array<T>& array() const { return array_; }
-    inline Array<T>& array() { return array_; }
-    inline bool is_pd() const { return is_pd_psd(false); }
-    inline bool is_psd() const { return is_pd_psd(true); }
-    inline bool operator==(const MatrixX& other) const { return array_ == other.array_; }
-    inline MatrixX operator*(T v) const { return MatrixX<T>{row(), col(), array_ * v}; }
-    inline MatrixX operator+(const MatrixX& other) const { return MatrixX<T>{row(), col(), array_ + other.array_}; }
-    inline MatrixX operator-(const MatrixX& other) const { return MatrixX<T>{row(), col(), array_ - other.array_}; }
+inline const char* phase_name(Phase p)
+{
+    static const char* names[]{"factor", "solve", "prox", "line_search", "check"};
+    return names[static_cast<int>(p)];
+}
 
-    MatrixX(int row, int col);
-    MatrixX(const MatrixX& other);
-    MatrixX(MatrixX&& other);
-    MatrixX& operator=(const MatrixX& other);
-    MatrixX& operator=(MatrixX&& other);
+// Solver observers see begin_phase/end_phase around the parts of an
+// iteration and iteration(fx, primal, dual) once per iteration, and declare
+// `static constexpr bool enabled`. PhaseScope and the solvers call them and
+// compute anything that only feeds them under `if constexpr (O::enabled)`,
+// so with NullObserver nothing is left.
+struct NullObserver
+{
+    static constexpr bool enabled{false};
+    inline void begin_phase(Phase) {}
+    inline void end_phase(Phase) {}
+    inline void iteration(double, double, double) {}
+}; // struct NullObserver
 
-    MatrixX(int row, int col, const Array<T>& other);
-    MatrixX(int row, int col, Array<T>&& other);
-    MatrixX& operator=(const Array<T>& other);
-    MatrixX& operator=(Array<T>&& other);
+template<typename O>
+struct PhaseScope
+{
+    PhaseScope(O& obs, Phase p) : obs_(obs), p_(p) { if constexpr (O::enabled) obs_.begin_phase(p_); }
+    ~PhaseScope() { if constexpr (O::enabled) obs_.end_phase(p_); }
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+private:
+    O& obs_;
+    Phase p_;
+}; // struct PhaseScope
 
-    MatrixX<T> t() const;
-    MatrixX<T> inv() const;
-    MatrixX<T> sub(int sr, int sc, int r, int c) const;
-    T det() const;
-    T trace() const;
-    T norm2() const;
-    T norm1() const;
-    void fill_rand_();
-    void fill_0_();
-    void fill_1_();
-    void resize_(int r, int c);
-    bool is_sym() const;
+// Observer recording one Record per iteration: objective, primal and dual
+// residual, seconds spent in every phase and wall time since construction
+// or clear(). An optional callback sees each record as it is added.
+struct SolverTrace
+{
+    using clock = std::chrono::steady_clock;
+    static constexpr bool enabled{true};
+    static constexpr int phases{static_cast<int>(Phase::count_)};
 
-    MatrixInitalizer operator<<(T v);
-    MatrixX operator*(const MatrixX& m) const;
+    struct Record
+    {
+        int iter;
+        double fx;
+        double primal;
+        double dual;
+        double seconds[phases];
+        double wall;
+    }; // struct Record
+
+    SolverTrace() { clear(); }
+
+    template<typename F>
+    void on_iteration(F&& fn) { callback_ = std::forward<F>(fn); }
+
+    inline void begin_phase(Phase p) { start_[static_cast<int>(p)] = clock::now(); }
+    inline void end_phase(Phase p);
+    void iteration(double fx, double primal, double dual);
+    void clear();
+
+    inline int size() const { return static_cast<int>(records_.size()); }
+    inline const Record& operator[](int i) const { return records_[i]; }
+    inline const Record& back() const { return records_.back(); }
+    inline const std::vector<Record>& records() const { return records_; }
+    // total seconds spent in a phase over all iterations
+    double total(Phase p) const;
+
+    void write_csv(std::ostream& os) const;
+    void write_json(std::ostream& os) const;
 private:
-    bool is_pd_psd(bool psd) const;
-}; // struct MatrixX
+    std::vector<Record> records_;
+    std::function<void(const Record&)> callback_;
+    clock::time_point origin_;
+    clock::time_point start_[phases];
+    double pending_[phases];
+}; // struct SolverTrace
 
-using MatrixXd = MatrixX<double>;
-using MatrixXf = MatrixX<float>;
-using MatrixXi = MatrixX<int>;
+inline void SolverTrace::end_phase(Phase p)
+{
+    const auto i{static_cast<int>(p)};
+    pending_[i] += std::chrono::duration<double>(clock::now() - start_[i]).count();
+}
 
-template<typename T, int R, int C>
-struct Matrix: public MatrixX<T>
+inline void SolverTrace::iteration(double fx, double primal, double dual)
 {
-    Matrix() : MatrixX<T>(R, C) {}
-    Matrix(const MatrixX<T>& other);
-    Matrix(MatrixX<T>&& other);
-    Matrix& operator=(const MatrixX<T>& other);
-    Matrix& operator=(MatrixX<T>&& other);
+    Record r{size(), fx, primal, dual, {}, std::chrono::duration<double>(clock::now() - origin_).count()};
+    std::copy(pending_, pending_ + phases, r.seconds);
+    std::fill(pending_, pending_ + phases, 0.0);
+    records_.push_back(r);
+    if (callback_) callback_(records_.back());
+}
 
-    Matrix(const Array<T>& other);
-    Matrix(Array<T>&& other);
-    Matrix& operator=(const Array<T>& other);
-    Matrix& operator=(Array<T>&& other);
+inline void SolverTrace::clear()
+{
+    records_.clear();
+    origin_ = clock::now();
+    std::fill(pending_, pending_ + phases, 0.0);
+}
+
+inline double SolverTrace::total(Phase p) const
+{
+    double s{0};
+    for (const auto& r : records_) s += r.seconds[static_cast<int>(p)];
+    return s;
+}
+
+inline void SolverTrace::write_csv(std::ostream& os) const
+{
+    const auto precision{os.precision(std::numeric_limits<double>::digits10)};
+    os << "iter,fx,primal,dual";
+    for (int p = 0; p < phases; ++p) os << ',' << phase_name(static_cast<Phase>(p));
+    os << ",wall\n";
+    for (const auto& r : records_) {
+        os << r.iter << ',' << r.fx << ',' << r.primal << ',' << r.dual;
+        for (int p = 0; p < phases; ++p) os << ',' << r.seconds[p];
+        os << ',' << r.wall << '\n';
+    }
+    os.precision(precision);
+}
+
+inline void SolverTrace::write_json(std::ostream& os) const
+{
+    // non finite values are not valid JSON numbers
+    auto number{[&os] (double v) -> std::ostream& { return std::isfinite(v) ? os << v : os << "null"; }};
+    const auto precision{os.precision(std::numeric_limits<double>::digits10)};
+    os << '[';
+    for (int i = 0; i < size(); ++i) {
+        const auto& r{records_[i]};
+        os << (i ? ",\n " : "") << "{\"iter\": " << r.iter;
+        os << ", \"fx\": ";
+        number(r.fx) << ", \"primal\": ";
+        number(r.primal) << ", \"dual\": ";
+        number(r.dual);
+        for (int p = 0; p < phases; ++p) os << ", \"" << phase_name(static_cast<Phase>(p)) << "\": " << r.seconds[p];
+        os << ", \"wall\": " << r.wall << '}';
+    }
+    os << "]\n";
+    os.precision(precision);
+}
+
+// Counter-based Philox4x32-10 generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3"). Block b of a stream is a pure function of
+// (seed, stream, b), element i of a fill always comes from the same block,
+// so results are independent of how the fill is split across threads.
+struct Philox
+{
+    Philox(std::uint64_t seed, std::uint64_t stream = 0) : seed_(seed), stream_(stream) {}
+
+    inline std::uint64_t seed() const { return seed_; }
+    inline std::uint64_t stream() const { return stream_; }
+    inline void block(std::uint64_t ctr, std::uint32_t out[4]) const { generate(ctr, 1, out); }
+    void generate(std::uint64_t first, int count, std::uint32_t* out) const;
+
+    // a fresh stream of the global seed, see qs::seed()
+    static Philox next();
+private:
+    std::uint64_t seed_;
+    std::uint64_t stream_;
+}; // struct Philox
+
+inline std::atomic<std::uint64_t>& rng_seed_()
+{
+    static std::atomic<std::uint64_t> seed{0x853c49e6748fea9bull};
+    return seed;
+}
+
+inline std::atomic<std::uint64_t>& rng_stream_()
+{
+    static std::atomic<std::uint64_t> stream{0};
+    return stream;
+}
+
+// reseed the generator behind fill_rand_() and friends, every later fill
+// draws the next stream of this seed
+inline void seed(std::uint64_t s)
+{
+    rng_seed_().store(s);
+    rng_stream_().store(0);
+}
+
+inline Philox Philox::next()
+{
+    return Philox(rng_seed_().load(), rng_stream_().fetch_add(1));
+}
+
+inline void Philox::generate(std::uint64_t first, int count, std::uint32_t* out) const
+{
+    // each block is independent, the loop carries no dependency and is
+    // left for the compiler to vectorize
+    for (int b = 0; b < count; ++b) {
+        const std::uint64_t ctr{first + b};
+        std::uint32_t c0{static_cast<std::uint32_t>(ctr)};
+        std::uint32_t c1{static_cast<std::uint32_t>(ctr >> 32)};
+        std::uint32_t c2{static_cast<std::uint32_t>(stream_)};
+        std::uint32_t c3{static_cast<std::uint32_t>(stream_ >> 32)};
+        std::uint32_t k0{static_cast<std::uint32_t>(seed_)};
+        std::uint32_t k1{static_cast<std::uint32_t>(seed_ >> 32)};
+        for (int r = 0; r < 10; ++r) {
+            const std::uint64_t p0{static_cast<std::uint64_t>(0xD2511F53u) * c0};
+            const std::uint64_t p1{static_cast<std::uint64_t>(0xCD9E8D57u) * c2};
+            const auto n0{static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k0};
+            const auto n2{static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k1};
+            c0 = n0;
+            c1 = static_cast<std::uint32_t>(p1);
+            c2 = n2;
+            c3 = static_cast<std::uint32_t>(p0);
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        out[4 * b + 0] = c0;
+        out[4 * b + 1] = c1;
+        out[4 * b + 2] = c2;
+        out[4 * b + 3] = c3;
+    }
+}
+
+namespace detail {
+
+// Fill p[0, n) from consecutive Philox blocks, each block of 128 bits
+// yields `per` elements (4 for 32-bit types, 2 for 64-bit types) through
+// gen(words, values).
+template<typename T, typename Gen>
+void fill_blocks(T* p, int n, const Philox& rng, Gen gen)
+{
+    constexpr int per{sizeof(T) <= 4 ? 4 : 2};
+    constexpr int batch{16};
+    const int blocks{(n + per - 1) / per};
+    parallel_for(blocks, 1 << 14, [&] (int b0, int b1) {
+        std::uint32_t w[4 * batch];
+        T v[per];
+        for (int b = b0; b < b1; b += batch) {
+            const auto count{std::min(batch, b1 - b)};
+            rng.generate(b, count, w);
+            for (int j = 0; j < count; ++j) {
+                gen(w + 4 * j, v);
+                const auto base{(b + j) * per};
+                const auto m{std::min(per, n - base)};
+                for (int k = 0; k < m; ++k) p[base + k] = v[k];
+            }
+        }
+    });
+}
+
+inline float u01f(std::uint32_t w) { return (w >> 8) * (1.0f / 16777216.0f); }
+inline double u01d(std::uint32_t hi, std::uint32_t lo)
+{
+    return ((static_cast<std::uint64_t>(hi) << 32 | lo) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// high 64 bits of the 128-bit product a * b
+inline std::uint64_t mulhi64(std::uint64_t a, std::uint64_t b)
+{
+    const std::uint64_t a0{a & 0xffffffffu}, a1{a >> 32}, b0{b & 0xffffffffu}, b1{b >> 32};
+    const std::uint64_t p00{a0 * b0}, p01{a0 * b1}, p10{a1 * b0}, p11{a1 * b1};
+    const std::uint64_t mid{(p00 >> 32) + (p01 & 0xffffffffu) + (p10 & 0xffffffffu)};
+    return p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+}
+
+template<typename T>
+void fill_uniform(T* p, int n, T lo, T hi, const Philox& rng)
+{
+    if constexpr (std::is_integral_v<T>) {
+        // [lo, hi] by multiply-shift, the range is taken modulo 2^64 so it
+        // cannot overflow, 0 stands for the full 64-bit range
+        const auto base{static_cast<std::uint64_t>(lo)};
+        const auto range{static_cast<std::uint64_t>(hi) - base + 1};
+        if constexpr (sizeof(T) <= 4) {
+            fill_blocks(p, n, rng, [=] (const std::uint32_t* w, T* v) {
+                for (int k = 0; k < 4; ++k) v[k] = static_cast<T>(base + ((w[k] * range) >> 32));
+            });
+        } else {
+            fill_blocks(p, n, rng, [=] (const std::uint32_t* w, T* v) {
+                for (int k = 0; k < 2; ++k) {
+                    const auto x{static_cast<std::uint64_t>(w[2 * k]) << 32 | w[2 * k + 1]};
+                    v[k] = static_cast<T>(base + (range ? mulhi64(x, range) : x));
+                }
+            });
+        }
+    } else if constexpr (sizeof(T) <= 4) {
+        fill_blocks(p, n, rng, [=] (const std::uint32_t* w, T* v) {
+            for (int k = 0; k < 4; ++k) v[k] = lo + (hi - lo) * static_cast<T>(u01f(w[k]));
+        });
+    } else {
+        fill_blocks(p, n, rng, [=] (const std::uint32_t* w, T* v) {
+            v[0] = lo + (hi - lo) * static_cast<T>(u01d(w[0], w[1]));
+            v[1] = lo + (hi - lo) * static_cast<T>(u01d(w[2], w[3]));
+        });
+    }
+}
+
+template<typename T>
+void fill_normal(T* p, int n, T mean, T stddev, const Philox& rng)
+{
+    static_assert(std::is_floating_point_v<T> || is_float16_v<T>);
+    // Box-Muller, one pair of normals per pair of uniforms, u1 in (0, 1];
+    // the math runs in accum_t<T> and each value is rounded once on store
+    using A = accum_t<T>;
+    constexpr A two_pi{static_cast<A>(6.283185307179586)};
+    const A mu{mean}, sigma{stddev};
+    if constexpr (sizeof(T) <= 4) {
+        fill_blocks(p, n, rng, [=] (const std::uint32_t* w, T* v) {
+            for (int k = 0; k < 4; k += 2) {
+                const auto r{std::sqrt(-2 * std::log(1 - u01f(w[k])))};
+                const auto theta{two_pi * u01f(w[k + 1])};
+                v[k] = static_cast<T>(mu + sigma * r * std::cos(theta));
+                v[k + 1] = static_cast<T>(mu + sigma * r * std::sin(theta));
+            }
+        });
+    } else {
+        fill_blocks(p, n, rng, [=] (const std::uint32_t* w, T* v) {
+            const auto r{std::sqrt(-2 * std::log(1 - u01d(w[0], w[1])))};
+            const auto theta{two_pi * u01d(w[2], w[3])};
+            v[0] = static_cast<T>(mu + sigma * r * std::cos(theta));
+            v[1] = static_cast<T>(mu + sigma * r * std::sin(theta));
+        });
+    }
+}
+
+template<typename T>
+void fill_bernoulli(T* p, int n, double prob, const Philox& rng)
+{
+    const auto threshold{static_cast<std::uint64_t>(std::clamp(prob, 0.0, 1.0) * 4294967296.0)};
+    fill_blocks(p, n, rng, [=] (const std::uint32_t* w, T* v) {
+        for (int k = 0; k < (sizeof(T) <= 4 ? 4 : 2); ++k) v[k] = w[k] < threshold ? T{1} : T{0};
+    });
+}
+
+} // namespace detail
+
+#ifndef QS_TRANSPOSE_BLOCK
+#define QS_TRANSPOSE_BLOCK 32
+#endif
+
+// Tunables of the blocked kernels. The defaults are safe everywhere, tune()
+// measures better ones for the machine and save_tuning/load_tuning keep them
+// in a profile file. A process picks up the profile named by the
+// QS_TUNING_PROFILE environment variable on first use. Change the tuning
+// before kernels run on other threads, reads are not synchronized.
+struct Tuning
+{
+    // gemm cache blocks: rows of A, shared dimension, columns of B
+    int gemm_mc{64};
+    int gemm_kc{256};
+    int gemm_nc{1024};
+    // rows of C updated together by the gemm micro kernel, 1, 2 or 4
+    int gemm_mr{4};
+    // leaf tile of the cache oblivious and in place transposes
+    int transpose_block{QS_TRANSPOSE_BLOCK};
+    // gemm goes parallel from 2mkn flops on, max() keeps it serial
+    std::int64_t parallel_flops{std::int64_t{1} << 26};
+
+    bool valid() const;
+}; // struct Tuning
+
+inline bool Tuning::valid() const
+{
+    auto in{[] (std::int64_t v, std::int64_t lo, std::int64_t hi) { return v >= lo && v <= hi; }};
+    return in(gemm_mc, 1, 1 << 16) && in(gemm_kc, 1, 1 << 16) && in(gemm_nc, 1, 1 << 20)
+        && (gemm_mr == 1 || gemm_mr == 2 || gemm_mr == 4)
+        && in(transpose_block, 4, 1024) && parallel_flops > 0;
+}
+
+namespace detail {
+
+inline bool parse_tuning(const std::string& path, Tuning& out);
+
+inline Tuning& tuning_()
+{
+    static Tuning t{[] {
+        Tuning init;
+        const char* path{std::getenv("QS_TUNING_PROFILE")};
+        if (path) parse_tuning(path, init);
+        return init;
+    }()};
+    return t;
+}
+
+} // namespace detail
+
+inline const Tuning& tuning() { return detail::tuning_(); }
+
+inline void set_tuning(const Tuning& t)
+{
+    QS_ASSERT(t.valid());
+    detail::tuning_() = t;
+}
+
+namespace detail {
+
+// Cache oblivious out of place transpose of the rows x cols block of src
+// (leading dimension src_ld) into dst (leading dimension dst_ld): split the
+// longer side in half until a tile fits in L1.
+template<typename T>
+void transpose(const T* src, int src_ld, T* dst, int dst_ld, int rows, int cols)
+{
+    QS_ASSERT_NO_ALIAS(src, (rows - 1) * src_ld + cols, dst, (cols - 1) * dst_ld + rows);
+    const auto block{tuning().transpose_block};
+    if (rows <= block && cols <= block) {
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) dst[c * dst_ld + r] = src[r * src_ld + c];
+        }
+    } else if (rows >= cols) {
+        const auto half{rows / 2};
+        transpose(src, src_ld, dst, dst_ld, half, cols);
+        transpose(src + half * src_ld, src_ld, dst + half, dst_ld, rows - half, cols);
+    } else {
+        const auto half{cols / 2};
+        transpose(src, src_ld, dst, dst_ld, rows, half);
+        transpose(src + half, src_ld, dst + half * dst_ld, dst_ld, rows, cols - half);
+    }
+}
+
+// c block (mb x nb) += a block (mb x kb) * b block (kb x nb) with leading
+// dimensions lda, ldb, ldc. MR rows of c are updated together so every
+// loaded row of b feeds MR unit stride axpys.
+template<typename T, int MR>
+void gemm_block(const T* a, const T* b, T* c, int lda, int ldb, int ldc, int mb, int kb, int nb)
+{
+    int i{0};
+    for (; i + MR <= mb; i += MR) {
+        for (int p = 0; p < kb; ++p) {
+            T av[MR];
+            for (int r = 0; r < MR; ++r) av[r] = a[(i + r) * lda + p];
+            const T* br{b + p * ldb};
+            for (int j = 0; j < nb; ++j) {
+                const T bv{br[j]};
+                for (int r = 0; r < MR; ++r) c[(i + r) * ldc + j] += av[r] * bv;
+            }
+        }
+    }
+    for (; i < mb; ++i) {
+        T* cr{c + i * ldc};
+        for (int p = 0; p < kb; ++p) {
+            const T av{a[i * lda + p]};
+            const T* br{b + p * ldb};
+            for (int j = 0; j < nb; ++j) cr[j] += av * br[j];
+        }
+    }
+}
+
+template<typename T>
+using gemm_kernel_t = void (*)(const T*, const T*, T*, int, int, int, int, int, int);
+
+template<typename T>
+gemm_kernel_t<T> gemm_kernel(const Tuning& t)
+{
+    return t.gemm_mr == 4 ? gemm_block<T, 4> : t.gemm_mr == 2 ? gemm_block<T, 2> : gemm_block<T, 1>;
+}
+
+// runs rows(i0, i1) over [0, m), split into gemm_mc row blocks across
+// threads from parallel_flops on
+template<typename F>
+void gemm_rows(int m, int k, int n, F&& rows)
+{
+    const auto& t{tuning()};
+    const auto flops{2 * static_cast<std::int64_t>(m) * k * n};
+    if (flops < t.parallel_flops || num_threads() == 1) {
+        rows(0, m);
+        return;
+    }
+    const auto blocks{(m + t.gemm_mc - 1) / t.gemm_mc};
+    parallel_for(blocks, 1, [&] (int b0, int b1) { rows(b0 * t.gemm_mc, std::min(b1 * t.gemm_mc, m)); });
+}
+
+// Float16 gemm on the float kernel. Panels are converted inside the blocked
+// loop into per thread scratch of mc x kc, kc x nc and mc x nc floats, so
+// nothing the size of a, b or c is copied. Each c tile is accumulated in
+// float over the whole k and rounded once, at the price of converting the b
+// panel again for every row block (1 / gemm_mc of the flops).
+template<typename F>
+void gemm_half(const Float16<F>* a, const Float16<F>* b, Float16<F>* c, int m, int k, int n)
+{
+    const auto& t{tuning()};
+    const auto kernel{gemm_kernel<float>(t)};
+    gemm_rows(m, k, n, [&] (int i0, int i1) {
+        const auto mc{std::min(t.gemm_mc, i1 - i0)};
+        const auto kc{std::min(t.gemm_kc, k)};
+        const auto nc{std::min(t.gemm_nc, n)};
+        std::vector<float> fa(static_cast<std::size_t>(mc) * kc);
+        std::vector<float> fb(static_cast<std::size_t>(kc) * nc);
+        std::vector<float> fc(static_cast<std::size_t>(mc) * nc);
+        for (int jc = 0; jc < n; jc += t.gemm_nc) {
+            const auto nb{std::min(t.gemm_nc, n - jc)};
+            for (int ic = i0; ic < i1; ic += t.gemm_mc) {
+                const auto mb{std::min(t.gemm_mc, i1 - ic)};
+                for (int r = 0; r < mb; ++r) to_float(c + (ic + r) * n + jc, fc.data() + r * nb, nb);
+                for (int pc = 0; pc < k; pc += t.gemm_kc) {
+                    const auto kb{std::min(t.gemm_kc, k - pc)};
+                    for (int p = 0; p < kb; ++p) to_float(b + (pc + p) * n + jc, fb.data() + p * nb, nb);
+                    for (int r = 0; r < mb; ++r) to_float(a + (ic + r) * k + pc, fa.data() + r * kb, kb);
+                    kernel(fa.data(), fb.data(), fc.data(), kb, nb, nb, mb, kb, nb);
+                }
+                for (int r = 0; r < mb; ++r) from_float(fc.data() + r * nb, c + (ic + r) * n + jc, nb);
+            }
+        }
+    });
+}
+
+// c(m x n) += a(m x k) * b(k x n), all row major and contiguous. Blocked by
+// the gemm_* tunables so a kc x nc panel of b stays in cache while mc rows
+// of a stream past it, row blocks go to threads above parallel_flops.
+template<typename T>
+void gemm(const T* a, const T* b, T* c, int m, int k, int n)
+{
+    QS_ASSERT_NO_ALIAS(a, m * k, c, m * n);
+    QS_ASSERT_NO_ALIAS(b, k * n, c, m * n);
+    if constexpr (is_float16_v<T>) {
+        gemm_half(a, b, c, m, k, n);
+    } else {
+        const auto& t{tuning()};
+        const auto kernel{gemm_kernel<T>(t)};
+        gemm_rows(m, k, n, [&] (int i0, int i1) {
+            for (int jc = 0; jc < n; jc += t.gemm_nc) {
+                const auto nb{std::min(t.gemm_nc, n - jc)};
+                for (int pc = 0; pc < k; pc += t.gemm_kc) {
+                    const auto kb{std::min(t.gemm_kc, k - pc)};
+                    for (int ic = i0; ic < i1; ic += t.gemm_mc) {
+                        const auto mb{std::min(t.gemm_mc, i1 - ic)};
+                        kernel(a + ic * k + pc, b + pc * n + jc, c + ic * n + jc, k, n, n, mb, kb, nb);
+                    }
+                }
+            }
+        });
+    }
+}
+
+// In place transpose of a square n x n matrix, swaps tiles across the
+// diagonal so both sides stay cache resident.
+template<typename T>
+void transpose_square_(T* p, int n)
+{
+    const auto b{tuning().transpose_block};
+    for (int r0 = 0; r0 < n; r0 += b) {
+        const auto r1{std::min(r0 + b, n)};
+        for (int c0 = r0; c0 < n; c0 += b) {
+            const auto c1{std::min(c0 + b, n)};
+            for (int r = r0; r < r1; ++r) {
+                for (int c = std::max(c0, r + 1); c < c1; ++c) std::swap(p[r * n + c], p[c * n + r]);
+            }
+        }
+    }
+}
+
+// In place transpose of a rows x cols matrix by following the cycles of
+// the permutation i -> i * rows mod (size - 1), one bit per element marks
+// the visited positions.
+template<typename T>
+void transpose_cycles_(T* p, int rows, int cols)
+{
+    const std::int64_t size{static_cast<std::int64_t>(rows) * cols};
+    if (size <= 2) return;
+    const auto last{size - 1};
+    std::vector<bool> visited(static_cast<std::size_t>(size));
+    for (std::int64_t start = 1; start < last; ++start) {
+        if (visited[start]) continue;
+        // element at start moves to start * rows mod last
+        auto i{start};
+        T carry{p[i]};
+        do {
+            const auto next{i * rows % last};
+            std::swap(carry, p[next]);
+            visited[next] = true;
+            i = next;
+        } while (i != start);
+    }
+}
+
+} // namespace detail
+
+struct TuneOptions
+{
+    // square gemm size used for the block and micro kernel search
+    int size{192};
+    // timed runs per candidate and round, interleaved with runs of the
+    // current choice
+    int repeats{11};
+    // a candidate replaces the current choice only when its median time
+    // ratio to it is this much below 1 in two separate rounds, so timing
+    // noise leaves the defaults in place
+    double margin{0.1};
+}; // struct TuneOptions
+
+namespace detail {
+
+// Runs fn() under the current tuning a and the candidate b in alternation,
+// `repeats` pairs after an untimed warm up of each, flipping the order every
+// pair so clock drift and load bursts hit both alike. Each time is the
+// faster of two back to back runs, which filters one off stalls, and the
+// median of the paired ratios ignores the bursts that remain. True when b
+// wins by the margin in two separate rounds. Leaves a installed.
+template<typename F>
+bool clearly_faster(const Tuning& b, const Tuning& a, const TuneOptions& opt, F&& fn)
+{
+    auto time{[&] (const Tuning& t) {
+        set_tuning(t);
+        auto best{std::numeric_limits<double>::max()};
+        for (int r = 0; r < 2; ++r) {
+            const auto t0{std::chrono::steady_clock::now()};
+            fn();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+        }
+        return best;
+    }};
+    set_tuning(a);
+    fn();
+    set_tuning(b);
+    fn();
+    std::vector<double> ratio(std::max(opt.repeats, 1));
+    const auto mid{ratio.begin() + ratio.size() / 2};
+    bool wins{true};
+    for (int round = 0; round < 2 && wins; ++round) {
+        for (std::size_t i = 0; i < ratio.size(); ++i) {
+            if (i % 2) {
+                const auto tb{time(b)};
+                ratio[i] = tb / time(a);
+            } else {
+                const auto ta{time(a)};
+                ratio[i] = time(b) / ta;
+            }
+        }
+        std::nth_element(ratio.begin(), mid, ratio.end());
+        wins = *mid < 1 - opt.margin;
+    }
+    set_tuning(a);
+    return wins;
+}
+
+inline const char* isa_name()
+{
+#if defined(__AVX512F__)
+    return "avx512";
+#elif defined(__AVX2__)
+    return "avx2";
+#elif defined(__ARM_NEON)
+    return "neon";
+#else
+    return "generic";
+#endif
+}
+
+} // namespace detail
+
+// Benchmark the candidate gemm blockings and micro kernels, transpose tiles
+// and the gemm thread cutoff on fixed inputs, in a fixed order, and install
+// the winners. The search starts from the default Tuning and only moves off
+// a default when a candidate is clearly faster, so repeated runs on the same
+// machine pick the same profile. Takes a couple of seconds with the default
+// options.
+inline Tuning tune(const TuneOptions& opt = TuneOptions{})
+{
+    Tuning t;
+    auto pick{[&] (auto& field, const auto& candidates, auto&& run) {
+        for (auto c : candidates) {
+            if (c == field) continue;
+            const auto current{field};
+            field = c;
+            const auto trial{t};
+            field = current;
+            if (detail::clearly_faster(trial, t, opt, run)) field = c;
+        }
+        set_tuning(t);
+    }};
+
+    const int n{opt.size};
+    std::vector<double> a(n * n), b(n * n), c(n * n);
+    detail::fill_uniform(a.data(), n * n, -1.0, 1.0, Philox(0x7e57));
+    detail::fill_uniform(b.data(), n * n, -1.0, 1.0, Philox(0x7e57, 1));
+    auto gemm{[&] (int m) {
+        std::fill(c.begin(), c.begin() + m * m, 0.0);
+        detail::gemm(a.data(), b.data(), c.data(), m, m, m);
+    }};
+
+    // serial search first, then the thread cutoff
+    const auto parallel_flops{t.parallel_flops};
+    t.parallel_flops = std::numeric_limits<std::int64_t>::max();
+    pick(t.gemm_mr, std::vector<int>{4, 2, 1}, [&] { gemm(n); });
+    pick(t.gemm_kc, std::vector<int>{256, 128, 64, 512}, [&] { gemm(n); });
+    pick(t.gemm_mc, std::vector<int>{64, 32, 16, 128}, [&] { gemm(n); });
+    pick(t.gemm_nc, std::vector<int>{1024, 512, 256, 2048}, [&] { gemm(n); });
+
+    const int tr{2 * n}, tc{3 * n};
+    std::vector<double> dst(static_cast<std::size_t>(tr) * tc);
+    std::vector<double> src(dst.size());
+    std::copy(a.begin(), a.end(), src.begin());
+    pick(t.transpose_block, std::vector<int>{QS_TRANSPOSE_BLOCK, 16, 64, 8, 128}, [&] {
+        detail::transpose(src.data(), tc, dst.data(), tr, tr, tc);
+    });
+
+    // smallest size where the threaded gemm beats the serial one
+    t.parallel_flops = parallel_flops;
+    if (num_threads() > 1) {
+        t.parallel_flops = std::numeric_limits<std::int64_t>::max();
+        for (int m : {32, 48, 64, 96, 128, 192}) {
+            if (m > n) break;
+            const auto flops{2 * static_cast<std::int64_t>(m) * m * m};
+            auto threaded{t};
+            threaded.parallel_flops = flops;
+            if (detail::clearly_faster(threaded, t, opt, [&] { gemm(m); })) {
+                t.parallel_flops = flops;
+                break;
+            }
+        }
+    }
+    set_tuning(t);
+    return t;
+}
+
+// Profile file, one key=value per line. It records the instruction set the
+// header was built for and the hardware thread count, a profile from another
+// machine or build is rejected.
+inline bool save_tuning(const std::string& path, const Tuning& t = tuning())
+{
+    std::ofstream os(path);
+    os << "# qs tuning profile\n";
+    os << "version=1\n";
+    os << "isa=" << detail::isa_name() << "\n";
+    os << "hardware_threads=" << std::thread::hardware_concurrency() << "\n";
+    os << "gemm_mc=" << t.gemm_mc << "\n";
+    os << "gemm_kc=" << t.gemm_kc << "\n";
+    os << "gemm_nc=" << t.gemm_nc << "\n";
+    os << "gemm_mr=" << t.gemm_mr << "\n";
+    os << "transpose_block=" << t.transpose_block << "\n";
+    os << "parallel_flops=" << t.parallel_flops << "\n";
+    return static_cast<bool>(os.flush());
+}
+
+namespace detail {
+
+// reads the profile at path into out, false when the file is missing,
+// malformed, out of range or from another machine. A profile that does not
+// name its isa and hardware thread count counts as from another machine.
+inline bool parse_tuning(const std::string& path, Tuning& out)
+{
+    std::ifstream is(path);
+    if (!is) return false;
+    Tuning t;
+    bool version{false}, isa{false}, threads{false};
+    std::string line;
+    while (std::getline(is, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        const auto eq{line.find('=')};
+        if (eq == std::string::npos) return false;
+        const auto key{line.substr(0, eq)};
+        const auto value{line.substr(eq + 1)};
+        char* end{nullptr};
+        const auto number{std::strtoll(value.c_str(), &end, 10)};
+        const bool numeric{!value.empty() && *end == '\0'};
+        if (key == "version") {
+            version = numeric && number == 1;
+        } else if (key == "isa") {
+            isa = value == detail::isa_name();
+        } else if (key == "hardware_threads") {
+            threads = numeric && number == std::thread::hardware_concurrency();
+        } else if (!numeric) {
+            return false;
+        } else if (key == "gemm_mc") {
+            t.gemm_mc = static_cast<int>(std::clamp<long long>(number, 0, 1 << 30));
+        } else if (key == "gemm_kc") {
+            t.gemm_kc = static_cast<int>(std::clamp<long long>(number, 0, 1 << 30));
+        } else if (key == "gemm_nc") {
+            t.gemm_nc = static_cast<int>(std::clamp<long long>(number, 0, 1 << 30));
+        } else if (key == "gemm_mr") {
+            t.gemm_mr = static_cast<int>(std::clamp<long long>(number, 0, 1 << 30));
+        } else if (key == "transpose_block") {
+            t.transpose_block = static_cast<int>(std::clamp<long long>(number, 0, 1 << 30));
+        } else if (key == "parallel_flops") {
+            t.parallel_flops = number;
+        }
+    }
+    if (!version || !isa || !threads || !t.valid()) return false;
+    out = t;
+    return true;
+}
+
+} // namespace detail
+
+// Installs the profile at path and returns true, keeps the current tuning
+// and returns false when the profile is not usable.
+inline bool load_tuning(const std::string& path)
+{
+    Tuning t;
+    if (!detail::parse_tuning(path, t)) return false;
+    detail::tuning_() = t;
+    return true;
+}
+
+// Load the profile at path, or tune and write it when there is no usable one.
+inline Tuning tune_once(const std::string& path, const TuneOptions& opt = TuneOptions{})
+{
+    if (load_tuning(path)) return tuning();
+    const auto t{tune(opt)};
+    save_tuning(path, t);
+    return t;
+}
+
+#ifndef QS_ARRAY_INLINE_CAPACITY
+#define QS_ARRAY_INLINE_CAPACITY 16
+#endif
+
+// Tag for constructors that leave the elements uninitialized, for buffers
+// that are about to be overwritten anyway
+struct uninitialized_t
+{
+    explicit constexpr uninitialized_t() = default;
+}; // struct uninitialized_t
+
+inline constexpr uninitialized_t uninitialized{};
+
+enum class HugePages
+{
+    // plain aligned heap blocks
+    none,
+    // 2 MiB aligned blocks with madvise(MADV_HUGEPAGE)
+    transparent,
+    // MAP_HUGETLB mappings, falls back to transparent when the huge page
+    // pool is empty
+    explicit_pages,
+}; // enum class HugePages
+
+// How large Array/MatrixX buffers are allocated and first touched. Huge
+// pages need Linux, elsewhere every mode allocates from the heap.
+struct AllocPolicy
+{
+    HugePages huge_pages{HugePages::none};
+    // blocks of at least this many bytes use huge pages
+    std::size_t huge_bytes{std::size_t{1} << 21};
+    // zero fills and copies of at least this many bytes run on the
+    // parallel_for workers, split into the gemm_mc row blocks gemm_rows
+    // hands out. With set_pin_threads(true) the worker that first touches
+    // a row block is the one that later runs the gemm on it, so the pages
+    // of A and C rows land on that worker's NUMA node. Off by default,
+    // since every large construction or copy then starts threads.
+    std::size_t parallel_touch_bytes{std::numeric_limits<std::size_t>::max()};
+}; // struct AllocPolicy
+
+namespace detail {
+
+inline AllocPolicy& alloc_policy_()
+{
+    static AllocPolicy policy;
+    return policy;
+}
+
+} // namespace detail
+
+inline const AllocPolicy& alloc_policy() { return detail::alloc_policy_(); }
+// like set_tuning, call it before allocating on other threads
+inline void set_alloc_policy(const AllocPolicy& p) { detail::alloc_policy_() = p; }
+
+namespace detail {
+
+// Every heap block starts with a header recording how it was obtained, so
+// it is freed correctly even after the policy changed. Data starts 64 bytes
+// in and keeps the 64 byte alignment.
+enum class BlockKind : std::uint32_t
+{
+    heap,
+    huge,
+    mapped,
+}; // enum class BlockKind
+
+struct BlockHeader
+{
+    std::size_t bytes;
+    BlockKind kind;
+}; // struct BlockHeader
+
+constexpr std::size_t block_header{64};
+constexpr std::size_t huge_page{std::size_t{1} << 21};
+
+inline void* allocate_bytes(std::size_t bytes)
+{
+    void* base{nullptr};
+    BlockKind kind{BlockKind::heap};
+    auto total{bytes + block_header};
+#if defined(__linux__)
+    const auto& policy{alloc_policy()};
+    if (policy.huge_pages != HugePages::none && bytes >= policy.huge_bytes) {
+        total = (total + huge_page - 1) / huge_page * huge_page;
+        if (policy.huge_pages == HugePages::explicit_pages) {
+            base = ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base == MAP_FAILED) {
+                base = nullptr;
+            } else {
+                kind = BlockKind::mapped;
+            }
+        }
+        if (!base) {
+            base = ::operator new(total, std::align_val_t{huge_page});
+            ::madvise(base, total, MADV_HUGEPAGE);
+            kind = BlockKind::huge;
+        }
+    }
+#endif
+    if (!base) base = ::operator new(total, std::align_val_t{64});
+    *static_cast<BlockHeader*>(base) = BlockHeader{total, kind};
+    return static_cast<char*>(base) + block_header;
+}
+
+inline void deallocate_bytes(void* p)
+{
+    auto* base{static_cast<char*>(p) - block_header};
+    const auto header{*reinterpret_cast<const BlockHeader*>(base)};
+    switch (header.kind) {
+#if defined(__linux__)
+    case BlockKind::mapped:
+        ::munmap(base, header.bytes);
+        break;
+#endif
+    case BlockKind::huge:
+        ::operator delete(base, std::align_val_t{huge_page});
+        break;
+    default:
+        ::operator delete(base, std::align_val_t{64});
+        break;
+    }
+}
+
+template<typename T>
+T* allocate(int n)
+{
+    return static_cast<T*>(allocate_bytes(sizeof(T) * static_cast<std::size_t>(n)));
+}
+
+template<typename T>
+void deallocate(T* p)
+{
+    deallocate_bytes(p);
+}
+
+// init(first, last) initializes elements [first, last) of a row major
+// rows x cols buffer of T. Large buffers are split like gemm_rows splits
+// its rows when the policy opts in (see AllocPolicy::parallel_touch_bytes).
+template<typename T, typename F>
+void first_touch(int rows, int cols, F&& init)
+{
+    const auto n{rows * cols};
+    if (sizeof(T) * static_cast<std::size_t>(n) < alloc_policy().parallel_touch_bytes || num_threads() == 1) {
+        init(0, n);
+        return;
+    }
+    const auto mc{tuning().gemm_mc};
+    const auto blocks{(rows + mc - 1) / mc};
+    parallel_for(blocks, 1, [&] (int b0, int b1) { init(b0 * mc * cols, std::min(b1 * mc, rows) * cols); });
+}
+
+// Contiguous buffer that keeps up to N elements inline and only goes to the
+// heap beyond that. Elements are trivially copyable numbers, new elements
+// are zero initialized. A buffer can also borrow external memory, it then
+// never reallocates: assignments copy into the borrowed elements and only a
+// move hands the borrow on, a copy is an owning deep copy. Resizing a
+// borrowed buffer or assigning it a different size aborts in every build.
+template<typename T, int N>
+struct SmallBuffer
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    explicit SmallBuffer(int size);
+    SmallBuffer(int size, uninitialized_t);
+    SmallBuffer(T* external, int size);
+    SmallBuffer(const SmallBuffer& other);
+    SmallBuffer(SmallBuffer&& other) noexcept;
+    SmallBuffer& operator=(const SmallBuffer& other);
+    SmallBuffer& operator=(SmallBuffer&& other) noexcept;
+    ~SmallBuffer();
+
+    inline T* data() { return ptr_; }
+    inline const T* data() const { return ptr_; }
+    inline int size() const { return size_; }
+    inline int capacity() const { return capacity_; }
+    inline bool is_inline() const { return ptr_ == inline_ptr(); }
+    inline bool is_borrowed() const { return borrowed_; }
+    // keeps the leading elements, zero fills the new ones
+    void resize(int size);
+private:
+    static constexpr int inline_capacity_{N > 0 ? N : 1};
+
+    inline T* inline_ptr() { return reinterpret_cast<T*>(inline_); }
+    inline const T* inline_ptr() const { return reinterpret_cast<const T*>(inline_); }
+    // make room for size elements, contents are unspecified afterwards
+    void reserve_discard(int size);
+    void release();
+
+    alignas(std::max<std::size_t>(alignof(T), 16)) unsigned char inline_[inline_capacity_ * sizeof(T)];
+    T* ptr_;
+    int size_;
+    int capacity_;
+    bool borrowed_;
+}; // struct SmallBuffer
+
+template<typename T, int N>
+SmallBuffer<T, N>::SmallBuffer(int size)
+    : ptr_(inline_ptr())
+    , size_(0)
+    , capacity_(inline_capacity_)
+    , borrowed_(false)
+{
+    reserve_discard(size);
+    size_ = size;
+    first_touch<T>(size_, 1, [this] (int b, int e) { std::fill(ptr_ + b, ptr_ + e, T{}); });
+}
+
+template<typename T, int N>
+SmallBuffer<T, N>::SmallBuffer(int size, uninitialized_t)
+    : ptr_(inline_ptr())
+    , size_(0)
+    , capacity_(inline_capacity_)
+    , borrowed_(false)
+{
+    reserve_discard(size);
+    size_ = size;
+}
+
+template<typename T, int N>
+SmallBuffer<T, N>::SmallBuffer(T* external, int size)
+    : ptr_(external)
+    , size_(size)
+    , capacity_(size)
+    , borrowed_(true)
+{}
+
+template<typename T, int N>
+SmallBuffer<T, N>::SmallBuffer(const SmallBuffer& other)
+    : ptr_(inline_ptr())
+    , size_(0)
+    , capacity_(inline_capacity_)
+    , borrowed_(false)
+{
+    reserve_discard(other.size_);
+    size_ = other.size_;
+    first_touch<T>(size_, 1, [&] (int b, int e) { std::copy(other.ptr_ + b, other.ptr_ + e, ptr_ + b); });
+}
+
+template<typename T, int N>
+SmallBuffer<T, N>::SmallBuffer(SmallBuffer&& other) noexcept
+    : ptr_(inline_ptr())
+    , size_(0)
+    , capacity_(inline_capacity_)
+    , borrowed_(false)
+{
+    *this = std::move(other);
+}
+
+template<typename T, int N>
+SmallBuffer<T, N>& SmallBuffer<T, N>::operator=(const SmallBuffer& other)
+{
+    if (this != &other) {
+        QS_VERIFY(!borrowed_ || size_ == other.size_);
+        reserve_discard(other.size_);
+        size_ = other.size_;
+        std::copy(other.ptr_, other.ptr_ + size_, ptr_);
+    }
+    return *this;
+}
+
+template<typename T, int N>
+SmallBuffer<T, N>& SmallBuffer<T, N>::operator=(SmallBuffer&& other) noexcept
+{
+    if (this == &other) return *this;
+    if (other.is_inline() || borrowed_) {
+        // inline contents cannot be stolen and borrowed memory is written
+        // through, copy the elements
+        QS_VERIFY(!borrowed_ || size_ == other.size_);
+        reserve_discard(other.size_);
+        size_ = other.size_;
+        std::copy(other.ptr_, other.ptr_ + size_, ptr_);
+        if (!other.is_inline()) return *this;
+    } else {
+        release();
+        ptr_ = other.ptr_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        borrowed_ = other.borrowed_;
+        other.ptr_ = other.inline_ptr();
+        other.capacity_ = inline_capacity_;
+        other.borrowed_ = false;
+    }
+    other.size_ = 0;
+    return *this;
+}
+
+template<typename T, int N>
+SmallBuffer<T, N>::~SmallBuffer()
+{
+    release();
+}
+
+template<typename T, int N>
+void SmallBuffer<T, N>::release()
+{
+    if (!is_inline() && !borrowed_) deallocate(ptr_);
+    ptr_ = inline_ptr();
+    capacity_ = inline_capacity_;
+    borrowed_ = false;
+}
+
+template<typename T, int N>
+void SmallBuffer<T, N>::reserve_discard(int size)
+{
+    if (size <= capacity_) return;
+    QS_VERIFY(!borrowed_);
+    release();
+    ptr_ = allocate<T>(size);
+    capacity_ = size;
+}
+
+template<typename T, int N>
+void SmallBuffer<T, N>::resize(int size)
+{
+    if (borrowed_) {
+        QS_VERIFY(size == size_);
+        return;
+    }
+    if (size > capacity_) {
+        T* p{size <= inline_capacity_ ? inline_ptr() : allocate<T>(size)};
+        std::copy(ptr_, ptr_ + size_, p);
+        if (!is_inline()) deallocate(ptr_);
+        ptr_ = p;
+        capacity_ = size;
+    } else if (size <= inline_capacity_ && !is_inline()) {
+        // shrinking back below the inline capacity frees the heap block
+        std::copy(ptr_, ptr_ + size, inline_ptr());
+        deallocate(ptr_);
+        ptr_ = inline_ptr();
+        capacity_ = inline_capacity_;
+    }
+    if (size > size_) std::fill(ptr_ + size_, ptr_ + size, T{});
+    size_ = size;
+}
+
+} // namespace detail
+
+template<typename T, int R, int C>
+struct Matrix;
+
+template<typename T>
+struct MatrixX;
+
+template<typename T>
+struct TriangularView;
+
+template<typename T>
+struct MatrixRef;
+
+template<typename T>
+struct Vectorwise;
+
+enum class Uplo
+{
+    lower,
+    upper,
+}; // enum class Uplo
+
+template<typename T>
+struct Array
+{
+    Array(int size);
+    Array(int size, uninitialized_t) : data_(size, uninitialized) { QS_ASSERT(size > 0); }
+    // borrows data[0, size), see Map
+    Array(T* data, int size) : data_(data, size) {}
+    Array(const Array& other);
+    Array(Array&& other);
+    Array& operator=(const Array& other);
+    Array& operator=(Array&& other);
+
+    bool operator==(const Array& other) const;
+    Array operator*(const Array& other) const;
+    Array operator*(T v) const;
+    Array operator+(const Array& other) const;
+    Array operator-(const Array& other) const;
+    Array operator+(T v) const;
+    Array operator-(T v) const;
+
+    inline T at(int i) const { QS_ASSERT(i >= 0 && i < size()); return data_.data()[i]; };
+    inline T& at(int i) { QS_ASSERT(i >= 0 && i < size()); return data_.data()[i]; };
+    inline int size() const { return data_.size(); };
+    inline T* data() { return data_.data(); }
+    inline const T* data() const { return data_.data(); }
+    inline bool is_borrowed() const { return data_.is_borrowed(); }
+
+    Array max(T v) const;
+    Array abs() const;
+    Array sign();
+    void max_(T v);
+    void abs_();
+    void fill_rand_(const Philox& rng = Philox::next());
+    void fill_uniform_(T lo, T hi, const Philox& rng = Philox::next());
+    void fill_normal_(T mean, T stddev, const Philox& rng = Philox::next());
+    void fill_bernoulli_(double p, const Philox& rng = Philox::next());
+private:
+    friend struct MatrixX<T>;
+
+    detail::SmallBuffer<T, QS_ARRAY_INLINE_CAPACITY> data_;
+}; // struct Array
+
+template<typename T>
+struct MatrixX
+{
+protected:
+    struct MatrixInitalizer
+    {
+        MatrixInitalizer(MatrixX* m) : m(m), i(1) {}
+        MatrixInitalizer& operator,(T v);
+        MatrixX* m;
+        int i;
+    }; // struct MatrixInitalizer
+
+    Array<T> array_;
+    int col_;
+    int row_;
+
+    void eye_();
+public:
+    static MatrixX<T> eye(int row_col);
+    inline int row() const { return row_; };
+    inline int col() const { return col_; };
+    inline int size() const { return array_.size(); };
+    inline T& at(int i) { return array_.at(i); };
+    inline T at(int i) const { return array_.at(i); };
+    inline T& at(int r, int c) { check(r, c); return array_.data()[r * col() + c]; };
+    inline T at(int r, int c) const { check(r, c); return array_.data()[r * col() + c]; };
+    inline T& operator()(int r, int c) { return at(r, c); }
+    inline T operator()(int r, int c) const { return at(r, c); }
+    inline T scalar() const { QS_ASSERT(is_scalar()); return array_.at(0); }
+    inline bool is_scalar() const { return size() == 1; }
+    inline T* data() { return array_.data(); }
+    inline const T* data() const { return array_.data(); }
+    inline const Array<T>& array() const { return array_; }
+    inline Array<T>& array() { return array_; }
+    inline bool is_pd() const { return is_pd_psd(false); }
+    inline bool is_psd() const { return is_pd_psd(true); }
+    inline bool operator==(const MatrixX& other) const { return array_ == other.array_; }
+    inline MatrixX operator*(T v) const { return MatrixX<T>{row(), col(), array_ * v}; }
+    inline MatrixX operator+(T v) const { return MatrixX<T>{row(), col(), array_ + v}; }
+    inline MatrixX operator-(T v) const { return MatrixX<T>{row(), col(), array_ - v}; }
+    MatrixX operator/(T v) const;
+
+    // Elementwise ops broadcast like NumPy: along each axis the sizes must
+    // match or one of them must be 1, a row or column vector is then reused
+    // for every row or column of the other operand without being expanded.
+    MatrixX operator+(const MatrixX& other) const;
+    MatrixX operator-(const MatrixX& other) const;
+    MatrixX emul(const MatrixX& other) const;
+    MatrixX ediv(const MatrixX& other) const;
+
+    // Per row (r x 1 result) or per column (1 x c result) reductions. The
+    // view borrows *this, or takes over a temporary.
+    Vectorwise<T> rowwise() const&;
+    Vectorwise<T> rowwise() &&;
+    Vectorwise<T> colwise() const&;
+    Vectorwise<T> colwise() &&;
+
+    MatrixX(int row, int col);
+    MatrixX(int row, int col, uninitialized_t) : array_(row * col, uninitialized), col_(col), row_(row) {}
+    MatrixX(const MatrixX& other);
+    MatrixX(MatrixX&& other);
+    MatrixX& operator=(const MatrixX& other);
+    MatrixX& operator=(MatrixX&& other);
+
+    MatrixX(int row, int col, const Array<T>& other);
+    MatrixX(int row, int col, Array<T>&& other);
+    MatrixX& operator=(const Array<T>& other);
+    MatrixX& operator=(Array<T>&& other);
+
+    MatrixX<T> t() const;
+    void t_();
+    TriangularView<T> upper(bool unit_diag = false) const&;
+    TriangularView<T> upper(bool unit_diag = false) &&;
+    TriangularView<T> lower(bool unit_diag = false) const&;
+    TriangularView<T> lower(bool unit_diag = false) &&;
+    MatrixX<T> inv() const;
+    MatrixX<T> sub(int sr, int sc, int r, int c) const;
+    MatrixRef<T> block(int sr, int sc, int r, int c);
+    MatrixRef<const T> block(int sr, int sc, int r, int c) const;
+    inline bool is_borrowed() const { return array_.is_borrowed(); }
+    T det() const;
+    T trace() const;
+    T norm2() const;
+    T norm1() const;
+    inline void fill_rand_(const Philox& rng = Philox::next()) { array_.fill_rand_(rng); }
+    inline void fill_uniform_(T lo, T hi, const Philox& rng = Philox::next()) { array_.fill_uniform_(lo, hi, rng); }
+    inline void fill_normal_(T mean, T stddev, const Philox& rng = Philox::next()) { array_.fill_normal_(mean, stddev, rng); }
+    inline void fill_bernoulli_(double p, const Philox& rng = Philox::next()) { array_.fill_bernoulli_(p, rng); }
+    void fill_0_();
+    void fill_1_();
+    void resize_(int r, int c);
+    bool is_sym() const;
+
+    MatrixInitalizer operator<<(T v);
+    MatrixX operator*(const MatrixX& m) const;
+private:
+    bool is_pd_psd(bool psd) const;
+    inline void check(int r, int c) const { QS_ASSERT(r >= 0 && r < row() && c >= 0 && c < col()); }
+    template<typename Op>
+    MatrixX broadcast(const MatrixX& other, Op op) const;
+}; // struct MatrixX
+
+using MatrixXd = MatrixX<double>;
+using MatrixXf = MatrixX<float>;
+using MatrixXi = MatrixX<int>;
+
+template<typename T, int R, int C>
+struct Matrix: public MatrixX<T>
+{
+    Matrix() : MatrixX<T>(R, C) {}
+    Matrix(const MatrixX<T>& other);
+    Matrix(MatrixX<T>&& other);
+    Matrix& operator=(const MatrixX<T>& other);
+    Matrix& operator=(MatrixX<T>&& other);
+
+    Matrix(const Array<T>& other);
+    Matrix(Array<T>&& other);
+    Matrix& operator=(const Array<T>& other);
+    Matrix& operator=(Array<T>&& other);
+
+    // transposing in place keeps R x C only for square shapes
+    inline void t_() { static_assert(R == C, "t_() would break the fixed R x C shape"); MatrixX<T>::t_(); }
+
+    static Matrix<T, R, C> eye();
+    static Matrix<T, R, C> rand();
+    static Matrix<T, R, C> rand(T lo, T hi);
+    static Matrix<T, R, C> randn(T mean = 0, T stddev = 1);
+    static Matrix<T, R, C> bernoulli(double p);
+    static Matrix<T, R, C> ones();
+    static Matrix<T, R, C> zeros();
+}; // struct Matrix
+
+template<int R, int C>
+using Matrixd = Matrix<double, R, C>;
+template<int R, int C>
+using Matrixf = Matrix<float, R, C>;
+template<int R, int C>
+using Matrixi = Matrix<int, R, C>;
+
+template<typename T, int DIM>
+using Vector = Matrix<T, DIM, 1>;
+template<int DIM>
+using Vectorf = Vector<float, DIM>;
+template<int DIM>
+using Vectord = Vector<double, DIM>;
+template<int DIM>
+using Vectori = Vector<int, DIM>;
+
+template<typename T, int R, int C>
+Matrix<T, R, C>::Matrix(const MatrixX<T>& other)
+    : MatrixX<T>(other)
+{}
+
+template<typename T, int R, int C>
+Matrix<T, R, C>::Matrix(MatrixX<T>&& other)
+    : MatrixX<T>(std::move(other))
+{}
+
+template<typename T, int R, int C>
+Matrix<T, R, C>& Matrix<T, R, C>::operator=(const MatrixX<T>& other)
+{
+    QS_ASSERT(R == other.row() && C == other.col());
+    this->array_ = other.array_;
+    return *this;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C>& Matrix<T, R, C>::operator=(MatrixX<T>&& other)
+{
+    QS_ASSERT(R == other.row() && C == other.col());
+    this->array_ = std::move(other.array());
+    return *this;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C>::Matrix(const Array<T>& other)
+    : MatrixX<T>(R, C, other)
+{}
+
+template<typename T, int R, int C>
+Matrix<T, R, C>::Matrix(Array<T>&& other)
+    : MatrixX<T>(R, C, std::move(other))
+{}
+
+template<typename T, int R, int C>
+Matrix<T, R, C>& Matrix<T, R, C>::operator=(const Array<T>& other)
+{
+    QS_ASSERT(R * C == other.size());
+    this->array_ = other;
+    return *this;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C>& Matrix<T, R, C>::operator=(Array<T>&& other)
+{
+    QS_ASSERT(R * C == other.size());
+    this->array_ = std::move(other);
+    return *this;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C> Matrix<T, R, C>::eye()
+{
+    static_assert(R == C);
+    Matrix<T, R, C> m;
+    m.eye_();
+    return m;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C> Matrix<T, R, C>::rand()
+{
+    Matrix<T, R, C> m;
+    m.fill_rand_();
+    return m;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C> Matrix<T, R, C>::rand(T lo, T hi)
+{
+    Matrix<T, R, C> m;
+    m.fill_uniform_(lo, hi);
+    return m;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C> Matrix<T, R, C>::randn(T mean, T stddev)
+{
+    Matrix<T, R, C> m;
+    m.fill_normal_(mean, stddev);
+    return m;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C> Matrix<T, R, C>::bernoulli(double p)
+{
+    Matrix<T, R, C> m;
+    m.fill_bernoulli_(p);
+    return m;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C> Matrix<T, R, C>::ones()
+{
+    Matrix<T, R, C> m;
+    m.fill_1_();
+    return m;
+}
+
+template<typename T, int R, int C>
+Matrix<T, R, C> Matrix<T, R, C>::zeros()
+{
+    Matrix<T, R, C> m;
+    m.fill_0_();
+    return m;
+}
+
+template<typename T>
+Array<T>::Array(int size)
+    : data_(size)
+{
+    QS_ASSERT(size > 0);
+}
+
+template<typename T>
+Array<T>::Array(const Array& other)
+    : data_(other.data_)
+{
+}
+
+template<typename T>
+Array<T>::Array(Array&& other)
+    : data_(std::move(other.data_))
+{
+}
+
+template<typename T>
+Array<T>& Array<T>::operator=(const Array& other)
+{
+    if (this != &other) {
+        data_ = other.data_;
+    }
+    return *this;
+}
+
+template<typename T>
+Array<T>& Array<T>::operator=(Array&& other)
+{
+    data_ = std::move(other.data_);
+    return *this;
+}
+
+template<typename T>
+bool Array<T>::operator==(const Array<T>& other) const
+{
+    const auto matrix_size{size()};
+    if (matrix_size != other.size()) return false;
+    return std::equal(data(), data() + matrix_size, other.data());
+}
+
+template<typename T>
+Array<T> Array<T>::operator*(const Array<T>& other) const
+{
+    QS_ASSERT(other.size() == size());
+    Array<T> out{*this};
+    detail::zip_(out.data(), other.data(), size(), std::multiplies<>());
+    return out;
+}
+
+template<typename T>
+Array<T> Array<T>::operator*(T v) const
+{
+    Array<T> out{*this};
+    const accum_t<T> w{v};
+    detail::map_(out.data(), size(), [w] (auto x) { return x * w; });
+    return out;
+}
+
+template<typename T>
+Array<T> Array<T>::operator+(const Array<T>& other) const
+{
+    QS_ASSERT(other.size() == size());
+    Array<T> out{*this};
+    detail::zip_(out.data(), other.data(), size(), std::plus<>());
+    return out;
+}
+
+template<typename T>
+Array<T> Array<T>::operator-(const Array<T>& other) const
+{
+    QS_ASSERT(other.size() == size());
+    Array<T> out{*this};
+    detail::zip_(out.data(), other.data(), size(), std::minus<>());
+    return out;
+}
+
+template<typename T>
+Array<T> Array<T>::operator+(T v) const
+{
+    Array<T> out{*this};
+    const accum_t<T> w{v};
+    detail::map_(out.data(), size(), [w] (auto x) { return x + w; });
+    return out;
+}
+
+template<typename T>
+Array<T> Array<T>::operator-(T v) const
+{
+    Array<T> out{*this};
+    const accum_t<T> w{v};
+    detail::map_(out.data(), size(), [w] (auto x) { return x - w; });
+    return out;
+}
+
+template<typename T>
+Array<T> Array<T>::sign()
+{
+    Array<T> out(size());
+    T* po{out.data()};
+    const T* pa{data()};
+    const auto array_size{size()};
+    for (int i = 0; i < array_size; ++i) {
+        po[i] = pa[i] > 0 ? 1 : -1;
+    }
+    return out;
+}
+
+template<typename T>
+void Array<T>::max_(T v)
+{
+    T* p{data()};
+    const auto array_size{size()};
+    for (int i = 0; i < array_size; ++i) {
+        p[i] = std::max(p[i], v);
+    }
+}
+
+template<typename T>
+void Array<T>::abs_()
+{
+    T* p{data()};
+    const auto array_size{size()};
+    for (int i = 0; i < array_size; ++i) {
+        p[i] = std::abs(p[i]);
+    }
+}
+
+template<typename T>
+Array<T> Array<T>::max(T v) const
+{
+    Array<T>out(*this);
+    out.max_(v);
+    return out;
+}
+
+template<typename T>
+Array<T> Array<T>::abs() const
+{
+    Array<T>out(*this);
+    out.abs_();
+    return out;
+}
+
+template<typename T>
+void Array<T>::fill_rand_(const Philox& rng)
+{
+    // integers in [0, 2^31 - 1], floating point in [0, 1)
+    if constexpr (std::is_integral_v<T>) {
+        fill_uniform_(0, static_cast<T>(std::min<std::int64_t>(std::numeric_limits<T>::max(), 0x7fffffff)), rng);
+    } else {
+        fill_uniform_(0, 1, rng);
+    }
+}
+
+template<typename T>
+void Array<T>::fill_uniform_(T lo, T hi, const Philox& rng)
+{
+    detail::fill_uniform(data(), size(), lo, hi, rng);
+}
+
+template<typename T>
+void Array<T>::fill_normal_(T mean, T stddev, const Philox& rng)
+{
+    detail::fill_normal(data(), size(), mean, stddev, rng);
+}
+
+template<typename T>
+void Array<T>::fill_bernoulli_(double p, const Philox& rng)
+{
+    detail::fill_bernoulli(data(), size(), p, rng);
+}
+
+template<typename T>
+typename MatrixX<T>::MatrixInitalizer MatrixX<T>::operator<<(T v)
+{
+    MatrixInitalizer mi(this);
+    array_.at(0) = v;
+    return mi;
+}
+
+template<typename T>
+typename MatrixX<T>::MatrixInitalizer& MatrixX<T>::MatrixInitalizer::operator,(T v)
+{
+    m->array_.at(i++) = v;
+    return *this;
+}
+
+template<typename T>
+MatrixX<T>::MatrixX(int row, int col)
+    : MatrixX(row, col, uninitialized)
+{
+    detail::first_touch<T>(row, col, [this] (int b, int e) { std::fill(data() + b, data() + e, T{}); });
+}
+
+template<typename T>
+MatrixX<T>::MatrixX(const MatrixX& other)
+    : MatrixX(other.row_, other.col_, uninitialized)
+{
+    detail::first_touch<T>(row_, col_, [&] (int b, int e) { std::copy(other.data() + b, other.data() + e, data() + b); });
+}
+
+template<typename T>
+MatrixX<T>::MatrixX(int row, int col, const Array<T>& other)
+    : array_(other)
+    , row_(row)
+    , col_(col)
+{
+    QS_ASSERT(row * col == array_.size());
+}
+
+template<typename T>
+MatrixX<T>::MatrixX(int row, int col, Array<T>&& other)
+    : array_(std::move(other))
+    , row_(row)
+    , col_(col)
+{
+    QS_ASSERT(row * col == array_.size());
+}
+
+template<typename T>
+MatrixX<T>::MatrixX(MatrixX&& other)
+    : MatrixX(other.row_, other.col_, std::move(other.array_))
+{
+}
+
+template<typename T>
+MatrixX<T>& MatrixX<T>::operator=(const MatrixX& other)
+{
+    if (this != &other) {
+        QS_VERIFY(!is_borrowed() || (row_ == other.row_ && col_ == other.col_));
+        array_ = other.array_;
+        row_ = other.row_;
+        col_ = other.col_;
+    }
+    return *this;
+}
+
+template<typename T>
+MatrixX<T>& MatrixX<T>::operator=(MatrixX&& other)
+{
+    QS_VERIFY(!is_borrowed() || (row_ == other.row_ && col_ == other.col_));
+    array_ = std::move(other.array_);
+    row_ = other.row_;
+    col_ = other.col_;
+    return *this;
+}
+
+template<typename T>
+MatrixX<T>& MatrixX<T>::operator=(const Array<T>& other)
+{
+    QS_ASSERT(size() == other.size());
+    array_ = other;
+    return *this;
+}
+
+template<typename T>
+MatrixX<T>& MatrixX<T>::operator=(Array<T>&& other)
+{
+    QS_ASSERT(size() == other.size());
+    array_ = std::move(other);
+    return *this;
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::eye(int row_col)
+{
+    MatrixX<T> m(row_col, row_col);
+    m.eye_();
+    return m;
+}
+
+template<typename T>
+void MatrixX<T>::eye_()
+{
+    QS_ASSERT(row() == col());
+    for (int i = 0; i < row(); ++i) {
+        at(i, i) = 1;
+    }
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::t() const
+{
+    MatrixX<T> m(col(), row(), uninitialized);
+    detail::transpose(data(), col(), m.data(), row(), row(), col());
+    return m;
+}
+
+template<typename T>
+void MatrixX<T>::t_()
+{
+    if (row() == col()) {
+        detail::transpose_square_(data(), row());
+    } else if (row() != 1 && col() != 1) {
+        detail::transpose_cycles_(data(), row(), col());
+    }
+    std::swap(row_, col_);
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::inv() const
+{
+    // Gauss Jordan algorithm
+    QS_ASSERT(row() == col());
+    auto out{MatrixX<T>::eye(row())};
+    auto tmp_m{*this};
+    const int n{row()};
+    T* po{out.data()};
+    T* pm{tmp_m.data()};
+
+    for (int c = 0; c < n; ++c) {
+        if (pm[c * n + c] == 0) {
+            // swap row
+            for (int r1 = c + 1; r1 < n; ++r1) {
+                if (pm[r1 * n + c] != 0) {
+                    std::swap_ranges(pm + c * n, pm + (c + 1) * n, pm + r1 * n);
+                    std::swap_ranges(po + c * n, po + (c + 1) * n, po + r1 * n);
+                    break;
+                }
+            }
+        }
+
+        T* mc{pm + c * n};
+        T* oc{po + c * n};
+        const auto tmp{mc[c]};
+        for (int c1 = 0; c1 < n; ++c1) {
+            mc[c1] /= tmp;
+            oc[c1] /= tmp;
+        }
+
+        for (int r = 0; r < n; ++r) {
+            if (r == c) continue;
+            T* mr{pm + r * n};
+            T* orow{po + r * n};
+            const auto t{mr[c]};
+            for (int c1 = 0; c1 < n; ++c1) {
+                orow[c1] -= oc[c1] * t;
+                mr[c1] -= t * mc[c1];
+            }
+        }
+    }
+
+    return out;
+}
+
+template<typename T>
+T MatrixX<T>::det() const
+{
+    QS_ASSERT(row() == col());
+
+    if (row() == 1) {
+        return array_.at(0);
+    } else if (row() == 2) {
+        return at(0, 0) * at(1, 1) - at(1, 0) * at(0, 1);
+    }
+
+    // calculate determinant with cofactor expansions
+    T result{0};
+    MatrixX<T> minor(row() - 1, col() - 1);
+    for (int c = 0; c < col(); ++c) {
+        T sign{(1 + 1 + c) % 2 == 0 ? static_cast<T>(1) : static_cast<T>(-1)};
+        T pivot{at(0, c)};
+
+        // expansion for first row
+        for (int mr = 1; mr < row(); ++mr) {
+            int cc{0};
+            for (int mc = 0; mc < col(); ++mc) {
+                if (c == mc) continue;
+                minor.at(mr - 1, cc++) = at(mr, mc);
+            }
+        }
+
+        result += sign * pivot * minor.det();
+    }
+    return result;
+}
+
+template<typename T>
+T MatrixX<T>::trace() const
+{
+    QS_ASSERT(row() == col());
+    const T* p{data()};
+    T result{0};
+    for (int r = 0; r < row(); ++r) {
+        result += p[r * col() + r];
+    }
+    return result;
+}
+
+template<typename T>
+T MatrixX<T>::norm2() const
+{
+    QS_ASSERT(col() == 1);
+
+    const T* p{data()};
+    const auto matrix_size{size()};
+    accum_t<T> result{0};
+    for (int i = 0; i < matrix_size; ++i) {
+        result += p[i] * p[i];
+    }
+    return std::sqrt(result);
+}
+
+template<typename T>
+T MatrixX<T>::norm1() const
+{
+    QS_ASSERT(col() == 1);
+
+    const T* p{data()};
+    const auto matrix_size{size()};
+    accum_t<T> result{0};
+    for (int i = 0; i < matrix_size; ++i) {
+        result += std::abs(p[i]);
+    }
+    return result;
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::sub(int sr, int sc, int r, int c) const
+{
+    // check
+    QS_ASSERT(sr >= 0 && sc >= 0);
+    QS_ASSERT(sr + r <= row() && sc + c <= col());
+
+    if (sr == 0 && sc == 0 && r == row() && c == col()) {
+        return *this;
+    } else {
+        MatrixX<T> out(r, c);
+        for (int i = 0; i < r; ++i) {
+            const T* src{data() + (sr + i) * col() + sc};
+            std::copy(src, src + c, out.data() + i * c);
+        }
+        return out;
+    }
+}
+
+template<typename T>
+void MatrixX<T>::fill_0_()
+{
+    std::fill(data(), data() + size(), 0);
+}
+
+template<typename T>
+void MatrixX<T>::fill_1_()
+{
+    std::fill(data(), data() + size(), 1);
+}
+
+template<typename T>
+void MatrixX<T>::resize_(int r, int c)
+{
+    QS_ASSERT(r > 0 && c > 0);
+    // a borrowed buffer can be reshaped but never grown or shrunk
+    QS_VERIFY(!is_borrowed() || r * c == size());
+    row_ = r;
+    col_ = c;
+    array_.data_.resize(c * r);
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::operator*(const MatrixX& m) const
+{
+    QS_ASSERT(col() == m.row());
+    MatrixX<T> out{row(), m.col()};
+    detail::gemm(data(), m.data(), out.data(), row(), col(), m.col());
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator*(T v, const MatrixX<T>& m)
+{
+    MatrixX<T> out{m};
+    T* po{out.data()};
+    auto matrix_size{m.size()};
+    for (int i = 0; i < matrix_size; ++i) {
+        po[i] *= v;
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator+(T v, const MatrixX<T>& m)
+{
+    return m + v;
+}
+
+template<typename T>
+MatrixX<T> operator-(T v, const MatrixX<T>& m)
+{
+    MatrixX<T> out{m};
+    const accum_t<T> w{v};
+    detail::map_(out.data(), out.size(), [w] (auto x) { return w - x; });
+    return out;
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::operator/(T v) const
+{
+    MatrixX<T> out{*this};
+    const accum_t<T> w{v};
+    detail::map_(out.data(), out.size(), [w] (auto x) { return x / w; });
+    return out;
+}
+
+template<typename T>
+template<typename Op>
+MatrixX<T> MatrixX<T>::broadcast(const MatrixX& other, Op op) const
+{
+    QS_ASSERT(row() == other.row() || row() == 1 || other.row() == 1);
+    QS_ASSERT(col() == other.col() || col() == 1 || other.col() == 1);
+    const auto r{row() == 1 ? other.row() : row()};
+    const auto c{col() == 1 ? other.col() : col()};
+    MatrixX<T> out{r, c, uninitialized};
+    detail::broadcast(data(), row(), col(), other.data(), other.row(), other.col(), out.data(), r, c, op);
+    return out;
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::operator+(const MatrixX& other) const
+{
+    if (row() == other.row() && col() == other.col()) return MatrixX<T>{row(), col(), array_ + other.array_};
+    return broadcast(other, std::plus<>());
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::operator-(const MatrixX& other) const
+{
+    if (row() == other.row() && col() == other.col()) return MatrixX<T>{row(), col(), array_ - other.array_};
+    return broadcast(other, std::minus<>());
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::emul(const MatrixX& other) const
+{
+    if (row() == other.row() && col() == other.col()) return MatrixX<T>{row(), col(), array_ * other.array_};
+    return broadcast(other, std::multiplies<>());
+}
+
+template<typename T>
+MatrixX<T> MatrixX<T>::ediv(const MatrixX& other) const
+{
+    return broadcast(other, std::divides<>());
+}
+
+template<typename T>
+struct Vectorwise
+{
+    Vectorwise(const MatrixX<T>& m, bool rows) : m_(&m), rows_(rows) {}
+    // takes ownership, so views of temporaries stay valid
+    Vectorwise(MatrixX<T>&& m, bool rows)
+        : owned_(std::make_shared<const MatrixX<T>>(std::move(m))), m_(owned_.get()), rows_(rows)
+    {}
+
+    inline MatrixX<T> sum() const { return reduce(detail::Reduce::sum); }
+    inline MatrixX<T> mean() const { return reduce(detail::Reduce::mean); }
+    inline MatrixX<T> norm() const { return reduce(detail::Reduce::norm); }
+    inline MatrixX<T> max() const { return reduce(detail::Reduce::max); }
+private:
+    MatrixX<T> reduce(detail::Reduce kind) const;
+
+    std::shared_ptr<const MatrixX<T>> owned_;
+    const MatrixX<T>* m_;
+    bool rows_;
+}; // struct Vectorwise
+
+template<typename T>
+MatrixX<T> Vectorwise<T>::reduce(detail::Reduce kind) const
+{
+    MatrixX<T> out{rows_ ? m_->row() : 1, rows_ ? 1 : m_->col(), uninitialized};
+    detail::reduce(m_->data(), m_->row(), m_->col(), rows_, kind, out.data());
+    return out;
+}
+
+template<typename T>
+Vectorwise<T> MatrixX<T>::rowwise() const&
+{
+    return Vectorwise<T>{*this, true};
+}
+
+template<typename T>
+Vectorwise<T> MatrixX<T>::rowwise() &&
+{
+    return Vectorwise<T>{std::move(*this), true};
+}
+
+template<typename T>
+Vectorwise<T> MatrixX<T>::colwise() const&
+{
+    return Vectorwise<T>{*this, false};
+}
+
+template<typename T>
+Vectorwise<T> MatrixX<T>::colwise() &&
+{
+    return Vectorwise<T>{std::move(*this), false};
+}
+
+template<typename T>
+bool MatrixX<T>::is_pd_psd(bool psd) const
+{
+    // Sylvester's criterion
+    QS_ASSERT(col() == row());
+
+    for (int i = 0; i < col(); ++i) {
+        T d{sub(i, i, row() - i, col() - i).det()};
+        if (d < 0 || (!psd && d == 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+bool MatrixX<T>::is_sym() const
+{
+    if (row() != col()) return false;
+    if (row() == 1) return true;
+
+    for (int r = 0; r < row(); ++r) {
+        for (int c = r + 1; c < col(); ++c) {
+            if (at(r, c) != at(c, r)) return false;
+        }
+    }
+    return true;
+}
+
+namespace detail {
+
+// keep 8-bit integers from printing as characters
+template<typename T>
+inline auto printable(T v)
+{
+    if constexpr (std::is_integral_v<T> && sizeof(T) == 1) {
+        return static_cast<int>(v);
+    } else if constexpr (is_float16_v<T>) {
+        return static_cast<float>(v);
+    } else {
+        return v;
+    }
+}
+
+} // namespace detail
+
+template<typename T>
+std::ostream& operator<<(std::ostream& os, const MatrixX<T>& m)
+{
+    os << "Matrix" << typeid(T).name() << "<" << m.row() << ", " << m.col() << ">{";
+    os << std::fixed << std::setprecision(QS_PRINT_PRECISION);
+    for (int i = 0; i < m.size(); ++i) {
+        if (i % m.col() == 0) { os << "\n  "; }
+        os << detail::printable(m.at(i)) << ", ";
+    }
+    os << "\n}";
+    return os;
+}
+
+template<typename T>
+std::ostream& operator<<(std::ostream& os, const Array<T>& a)
+{
+    os << "Array" << typeid(T).name() << "<" << a.size() << ">{";
+    os << std::fixed << std::setprecision(QS_PRINT_PRECISION);
+    const auto array_size{a.size()};
+    for (int i = 0; i < array_size; ++i) {
+        os << detail::printable(a.at(i));
+        if (i != array_size - 1) os << ", ";
+    }
+    os << "}";
+    return os;
+}
+
+// MatrixX over externally owned, contiguous row major memory. Nothing is
+// copied or freed: every kernel taking a MatrixX reads and writes the
+// external buffer directly, assigning to a Map writes through and its shape
+// is fixed. Copies of a MatrixX made from a Map are ordinary owning copies.
+template<typename T>
+struct Map: public MatrixX<T>
+{
+    Map(T* data, int row, int col) : MatrixX<T>(row, col, Array<T>(data, row * col)) {}
+    Map(const Map& other) : Map(const_cast<T*>(other.data()), other.row(), other.col()) {}
+    Map(Map&& other) = default;
+
+    Map& operator=(const Map& other) { return *this = static_cast<const MatrixX<T>&>(other); }
+    Map& operator=(const MatrixX<T>& other);
+    Map& operator=(MatrixX<T>&& other) { return *this = static_cast<const MatrixX<T>&>(other); }
+}; // struct Map
+
+// Read only Map. It is a separate view type rather than a MatrixX, so
+// nothing that mutates a MatrixX accepts it. It converts to
+// `const MatrixX<T>&` for everything that only reads.
+template<typename T>
+struct Map<const T>
+{
+    Map(const T* data, int row, int col) : m_(row, col, Array<T>(const_cast<T*>(data), row * col)) {}
+    Map(const Map& other) : Map(other.data(), other.row(), other.col()) {}
+    Map& operator=(const Map&) = delete;
+
+    inline int row() const { return m_.row(); }
+    inline int col() const { return m_.col(); }
+    inline int size() const { return m_.size(); }
+    inline T at(int i) const { return m_.at(i); }
+    inline T at(int r, int c) const { return m_.at(r, c); }
+    inline T operator()(int r, int c) const { return m_.at(r, c); }
+    inline const T* data() const { return m_.data(); }
+    inline const Array<T>& array() const { return m_.array(); }
+    inline const MatrixX<T>& matrix() const { return m_; }
+    inline operator const MatrixX<T>&() const { return m_; }
+
+    inline MatrixX<T> t() const { return m_.t(); }
+    inline MatrixRef<const T> block(int sr, int sc, int r, int c) const { return m_.block(sr, sc, r, c); }
+    inline MatrixX<T> operator*(const MatrixX<T>& other) const { return m_ * other; }
+    inline MatrixX<T> operator+(const MatrixX<T>& other) const { return m_ + other; }
+    inline MatrixX<T> operator-(const MatrixX<T>& other) const { return m_ - other; }
+    inline MatrixX<T> operator*(T v) const { return m_ * v; }
+    inline bool operator==(const MatrixX<T>& other) const { return m_ == other; }
+private:
+    MatrixX<T> m_;
+}; // struct Map<const T>
+
+// Strided view, element (r, c) is data[r * row_stride + c * col_stride].
+// Blocks of a MatrixX come out as refs, a ref with unit column stride and
+// row stride == col() is contiguous and can be used as a Map.
+template<typename T>
+struct MatrixRef
+{
+    using value_type = std::remove_const_t<T>;
+
+    MatrixRef(T* data, int row, int col, int row_stride, int col_stride = 1);
+    MatrixRef(MatrixX<value_type>& m) : MatrixRef(m.data(), m.row(), m.col(), m.col()) {}
+    MatrixRef(const MatrixX<value_type>& m) : MatrixRef(m.data(), m.row(), m.col(), m.col()) {}
+
+    inline int row() const { return row_; }
+    inline int col() const { return col_; }
+    inline int size() const { return row_ * col_; }
+    inline int row_stride() const { return row_stride_; }
+    inline int col_stride() const { return col_stride_; }
+    inline T* data() const { return data_; }
+    inline T* row_data(int r) const { return data_ + static_cast<std::ptrdiff_t>(r) * row_stride_; }
+    inline T& at(int r, int c) const;
+    inline T& operator()(int r, int c) const { return at(r, c); }
+    inline bool is_contiguous() const { return col_stride_ == 1 && row_stride_ == col_; }
+
+    MatrixRef block(int sr, int sc, int r, int c) const;
+    MatrixRef<T> t() const { return MatrixRef<T>(data_, col_, row_, col_stride_, row_stride_); }
+    MatrixX<value_type> eval() const;
+    Map<T> map() const;
+    // copy other into the viewed elements
+    const MatrixRef& assign(const MatrixX<value_type>& other) const;
+private:
+    T* data_;
+    int row_;
+    int col_;
+    int row_stride_;
+    int col_stride_;
+}; // struct MatrixRef
+
+template<typename T>
+Map<T>& Map<T>::operator=(const MatrixX<T>& other)
+{
+    QS_VERIFY(this->row() == other.row() && this->col() == other.col());
+    QS_ASSERT(this->data() == other.data() || !detail::overlaps(this->data(), this->size(), other.data(), other.size()));
+    std::copy(other.data(), other.data() + other.size(), this->data());
+    return *this;
+}
+
+template<typename T>
+MatrixRef<T>::MatrixRef(T* data, int row, int col, int row_stride, int col_stride)
+    : data_(data)
+    , row_(row)
+    , col_(col)
+    , row_stride_(row_stride)
+    , col_stride_(col_stride)
+{
+    QS_ASSERT(row > 0 && col > 0);
+}
+
+template<typename T>
+T& MatrixRef<T>::at(int r, int c) const
+{
+    QS_ASSERT(r >= 0 && r < row_ && c >= 0 && c < col_);
+    return data_[static_cast<std::ptrdiff_t>(r) * row_stride_ + static_cast<std::ptrdiff_t>(c) * col_stride_];
+}
+
+template<typename T>
+MatrixRef<T> MatrixRef<T>::block(int sr, int sc, int r, int c) const
+{
+    QS_ASSERT(sr >= 0 && sc >= 0 && sr + r <= row_ && sc + c <= col_);
+    return MatrixRef<T>(&at(sr, sc), r, c, row_stride_, col_stride_);
+}
+
+template<typename T>
+MatrixX<typename MatrixRef<T>::value_type> MatrixRef<T>::eval() const
+{
+    MatrixX<value_type> out(row_, col_, uninitialized);
+    value_type* po{out.data()};
+    for (int r = 0; r < row_; ++r) {
+        if (col_stride_ == 1) {
+            std::copy(row_data(r), row_data(r) + col_, po + r * col_);
+        } else {
+            for (int c = 0; c < col_; ++c) po[r * col_ + c] = at(r, c);
+        }
+    }
+    return out;
+}
+
+template<typename T>
+Map<T> MatrixRef<T>::map() const
+{
+    QS_ASSERT(is_contiguous());
+    return Map<T>(data_, row_, col_);
+}
+
+template<typename T>
+const MatrixRef<T>& MatrixRef<T>::assign(const MatrixX<value_type>& other) const
+{
+    static_assert(!std::is_const_v<T>);
+    QS_ASSERT(row_ == other.row() && col_ == other.col());
+    const value_type* src{other.data()};
+    for (int r = 0; r < row_; ++r) {
+        if (col_stride_ == 1) {
+            std::copy(src + r * col_, src + (r + 1) * col_, row_data(r));
+        } else {
+            for (int c = 0; c < col_; ++c) at(r, c) = src[r * col_ + c];
+        }
+    }
+    return *this;
+}
+
+template<typename T>
+MatrixRef<T> MatrixX<T>::block(int sr, int sc, int r, int c)
+{
+    return MatrixRef<T>(*this).block(sr, sc, r, c);
+}
+
+template<typename T>
+MatrixRef<const T> MatrixX<T>::block(int sr, int sc, int r, int c) const
+{
+    return MatrixRef<const T>(*this).block(sr, sc, r, c);
+}
+
+// Diagonal matrix, stores only the n diagonal entries
+template<typename T>
+struct DiagonalMatrix
+{
+    explicit DiagonalMatrix(int n) : d_(n, 1) {}
+    explicit DiagonalMatrix(const MatrixX<T>& d);
+
+    static DiagonalMatrix<T> identity(int n, T s = 1);
+    inline int row() const { return d_.row(); }
+    inline int col() const { return d_.row(); }
+    inline T& at(int i) { return d_.at(i); }
+    inline T at(int i) const { return d_.at(i); }
+    inline T at(int r, int c) const { return r == c ? d_.at(r) : T{0}; }
+    inline const MatrixX<T>& diagonal() const { return d_; }
+
+    MatrixX<T> to_dense() const;
+    MatrixX<T> solve(const MatrixX<T>& b) const;
+    DiagonalMatrix inv() const;
+    DiagonalMatrix operator*(const DiagonalMatrix& other) const;
+    DiagonalMatrix operator+(const DiagonalMatrix& other) const;
+    DiagonalMatrix operator-(const DiagonalMatrix& other) const;
+    DiagonalMatrix operator*(T v) const;
+private:
+    MatrixX<T> d_;
+}; // struct DiagonalMatrix
+
+// Read only view of the upper or lower triangle of a square MatrixX, the
+// other triangle is treated as zero
+template<typename T>
+struct TriangularView
+{
+    TriangularView(const MatrixX<T>& m, Uplo uplo, bool unit_diag = false);
+    // takes ownership, so views of temporaries stay valid
+    TriangularView(MatrixX<T>&& m, Uplo uplo, bool unit_diag = false);
+
+    inline int row() const { return m_->row(); }
+    inline int col() const { return m_->col(); }
+    inline Uplo uplo() const { return uplo_; }
+    inline T at(int r, int c) const;
+
+    MatrixX<T> to_dense() const;
+    MatrixX<T> solve(const MatrixX<T>& b) const;
+    MatrixX<T> operator*(const MatrixX<T>& b) const;
+private:
+    std::shared_ptr<const MatrixX<T>> owned_;
+    const MatrixX<T>* m_;
+    Uplo uplo_;
+    bool unit_diag_;
+}; // struct TriangularView
+
+// Symmetric matrix in packed storage, the lower triangle row by row,
+// n(n+1)/2 entries
+template<typename T>
+struct SymmetricMatrix
+{
+    explicit SymmetricMatrix(int n) : data_(n * (n + 1) / 2), n_(n) {}
+    // takes the lower triangle of m
+    explicit SymmetricMatrix(const MatrixX<T>& m);
+
+    inline int row() const { return n_; }
+    inline int col() const { return n_; }
+    inline int size() const { return data_.size(); }
+    inline T& at(int r, int c) { return data_.at(index(r, c)); }
+    inline T at(int r, int c) const { return data_.at(index(r, c)); }
+
+    MatrixX<T> to_dense() const;
+    // LDL^T without pivoting, for positive definite (or quasi-definite) matrices
+    MatrixX<T> solve(const MatrixX<T>& b) const;
+    MatrixX<T> operator*(const MatrixX<T>& b) const;
+    SymmetricMatrix operator+(const SymmetricMatrix& other) const;
+    SymmetricMatrix operator+(const DiagonalMatrix<T>& d) const;
+    SymmetricMatrix operator*(T v) const;
+private:
+    static inline int index(int r, int c) { return r >= c ? r * (r + 1) / 2 + c : c * (c + 1) / 2 + r; }
+
+    Array<T> data_;
+    int n_;
+}; // struct SymmetricMatrix
+
+// Square banded matrix with kl sub and ku super diagonals, stored row by
+// row as n x (kl + ku + 1), entry (r, c) sits at r * width + c - r + kl
+template<typename T>
+struct BandedMatrix
+{
+    BandedMatrix(int n, int kl, int ku);
+    BandedMatrix(const MatrixX<T>& m, int kl, int ku);
+
+    inline int row() const { return n_; }
+    inline int col() const { return n_; }
+    inline int kl() const { return kl_; }
+    inline int ku() const { return ku_; }
+    inline bool in_band(int r, int c) const { return c - r >= -kl_ && c - r <= ku_; }
+    inline T& at(int r, int c) { QS_ASSERT(in_band(r, c)); return data_.at(r * width() + c - r + kl_); }
+    inline T at(int r, int c) const { return in_band(r, c) ? data_.at(r * width() + c - r + kl_) : T{0}; }
+
+    MatrixX<T> to_dense() const;
+    // banded LU with partial pivoting, O(n kl (kl + ku)) per right hand side
+    MatrixX<T> solve(const MatrixX<T>& b) const;
+    MatrixX<T> operator*(const MatrixX<T>& b) const;
+    BandedMatrix operator+(const BandedMatrix& other) const;
+    BandedMatrix operator+(const DiagonalMatrix<T>& d) const;
+    BandedMatrix operator*(T v) const;
+private:
+    inline int width() const { return kl_ + ku_ + 1; }
+
+    Array<T> data_;
+    int n_;
+    int kl_;
+    int ku_;
+}; // struct BandedMatrix
+
+template<typename T>
+DiagonalMatrix<T>::DiagonalMatrix(const MatrixX<T>& d)
+    : d_(d.size(), 1, d.array())
+{
+    QS_ASSERT(d.row() == 1 || d.col() == 1);
+}
+
+template<typename T>
+DiagonalMatrix<T> DiagonalMatrix<T>::identity(int n, T s)
+{
+    DiagonalMatrix<T> out(n);
+    std::fill(out.d_.data(), out.d_.data() + n, s);
+    return out;
+}
+
+template<typename T>
+MatrixX<T> DiagonalMatrix<T>::to_dense() const
+{
+    MatrixX<T> out(row(), col());
+    for (int i = 0; i < row(); ++i) out.at(i, i) = at(i);
+    return out;
+}
+
+template<typename T>
+MatrixX<T> DiagonalMatrix<T>::solve(const MatrixX<T>& b) const
+{
+    QS_ASSERT(b.row() == row());
+    MatrixX<T> out{b};
+    T* po{out.data()};
+    for (int r = 0; r < out.row(); ++r) {
+        const auto s{1 / at(r)};
+        for (int c = 0; c < out.col(); ++c) po[r * out.col() + c] *= s;
+    }
+    return out;
+}
+
+template<typename T>
+DiagonalMatrix<T> DiagonalMatrix<T>::inv() const
+{
+    DiagonalMatrix<T> out(row());
+    for (int i = 0; i < row(); ++i) out.at(i) = 1 / at(i);
+    return out;
+}
+
+template<typename T>
+DiagonalMatrix<T> DiagonalMatrix<T>::operator*(const DiagonalMatrix& other) const
+{
+    QS_ASSERT(row() == other.row());
+    return DiagonalMatrix<T>(MatrixX<T>{row(), 1, d_.array() * other.d_.array()});
+}
+
+template<typename T>
+DiagonalMatrix<T> DiagonalMatrix<T>::operator+(const DiagonalMatrix& other) const
+{
+    return DiagonalMatrix<T>(d_ + other.d_);
+}
+
+template<typename T>
+DiagonalMatrix<T> DiagonalMatrix<T>::operator-(const DiagonalMatrix& other) const
+{
+    return DiagonalMatrix<T>(d_ - other.d_);
+}
+
+template<typename T>
+DiagonalMatrix<T> DiagonalMatrix<T>::operator*(T v) const
+{
+    return DiagonalMatrix<T>(d_ * v);
+}
+
+template<typename T>
+DiagonalMatrix<T> operator*(T v, const DiagonalMatrix<T>& d) { return d * v; }
+
+// D * M scales the rows of M
+template<typename T>
+MatrixX<T> operator*(const DiagonalMatrix<T>& d, const MatrixX<T>& m)
+{
+    QS_ASSERT(d.col() == m.row());
+    MatrixX<T> out{m};
+    T* po{out.data()};
+    for (int r = 0; r < m.row(); ++r) {
+        const auto s{d.at(r)};
+        for (int c = 0; c < m.col(); ++c) po[r * m.col() + c] *= s;
+    }
+    return out;
+}
+
+// M * D scales the columns of M
+template<typename T>
+MatrixX<T> operator*(const MatrixX<T>& m, const DiagonalMatrix<T>& d)
+{
+    QS_ASSERT(m.col() == d.row());
+    MatrixX<T> out{m};
+    T* po{out.data()};
+    const T* pd{d.diagonal().data()};
+    for (int r = 0; r < m.row(); ++r) {
+        for (int c = 0; c < m.col(); ++c) po[r * m.col() + c] *= pd[c];
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator+(const MatrixX<T>& m, const DiagonalMatrix<T>& d)
+{
+    QS_ASSERT(m.row() == d.row() && m.col() == d.col());
+    MatrixX<T> out{m};
+    T* po{out.data()};
+    for (int i = 0; i < d.row(); ++i) po[i * m.col() + i] += d.at(i);
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator+(const DiagonalMatrix<T>& d, const MatrixX<T>& m) { return m + d; }
+
+template<typename T>
+MatrixX<T> operator-(const MatrixX<T>& m, const DiagonalMatrix<T>& d) { return m + d * T{-1}; }
+
+template<typename T>
+MatrixX<T> operator-(const DiagonalMatrix<T>& d, const MatrixX<T>& m) { return m * T{-1} + d; }
+
+template<typename T>
+TriangularView<T>::TriangularView(const MatrixX<T>& m, Uplo uplo, bool unit_diag)
+    : m_(&m)
+    , uplo_(uplo)
+    , unit_diag_(unit_diag)
+{
+    QS_ASSERT(m.row() == m.col());
+}
+
+template<typename T>
+TriangularView<T>::TriangularView(MatrixX<T>&& m, Uplo uplo, bool unit_diag)
+    : owned_(std::make_shared<const MatrixX<T>>(std::move(m)))
+    , m_(owned_.get())
+    , uplo_(uplo)
+    , unit_diag_(unit_diag)
+{
+    QS_ASSERT(m_->row() == m_->col());
+}
+
+template<typename T>
+T TriangularView<T>::at(int r, int c) const
+{
+    if (r == c && unit_diag_) return T{1};
+    const bool inside{uplo_ == Uplo::upper ? c >= r : c <= r};
+    return inside ? m_->at(r, c) : T{0};
+}
+
+template<typename T>
+MatrixX<T> TriangularView<T>::to_dense() const
+{
+    MatrixX<T> out(row(), col());
+    for (int r = 0; r < row(); ++r) {
+        for (int c = 0; c < col(); ++c) out.at(r, c) = at(r, c);
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> TriangularView<T>::solve(const MatrixX<T>& b) const
+{
+    // forward (lower) or back (upper) substitution, all columns of b at once
+    QS_ASSERT(b.row() == row());
+    const int n{row()};
+    const int k{b.col()};
+    const T* pm{m_->data()};
+    MatrixX<T> x{b};
+    T* px{x.data()};
+    const bool lower{uplo_ == Uplo::lower};
+    for (int s = 0; s < n; ++s) {
+        const int i{lower ? s : n - 1 - s};
+        T* xi{px + i * k};
+        const int j0{lower ? 0 : i + 1};
+        const int j1{lower ? i : n};
+        for (int j = j0; j < j1; ++j) {
+            const auto a{pm[i * n + j]};
+            const T* xj{px + j * k};
+            for (int c = 0; c < k; ++c) xi[c] -= a * xj[c];
+        }
+        if (!unit_diag_) {
+            const auto d{1 / pm[i * n + i]};
+            for (int c = 0; c < k; ++c) xi[c] *= d;
+        }
+    }
+    return x;
+}
+
+template<typename T>
+MatrixX<T> TriangularView<T>::operator*(const MatrixX<T>& b) const
+{
+    QS_ASSERT(col() == b.row());
+    const int n{row()};
+    const int k{b.col()};
+    const T* pm{m_->data()};
+    const T* pb{b.data()};
+    MatrixX<T> out(n, k);
+    T* po{out.data()};
+    for (int i = 0; i < n; ++i) {
+        const int j0{uplo_ == Uplo::upper ? i : 0};
+        const int j1{uplo_ == Uplo::upper ? n : i + 1};
+        for (int j = j0; j < j1; ++j) {
+            const auto a{j == i && unit_diag_ ? T{1} : pm[i * n + j]};
+            for (int c = 0; c < k; ++c) po[i * k + c] += a * pb[j * k + c];
+        }
+    }
+    return out;
+}
+
+template<typename T>
+TriangularView<T> MatrixX<T>::upper(bool unit_diag) const&
+{
+    return TriangularView<T>(*this, Uplo::upper, unit_diag);
+}
+
+template<typename T>
+TriangularView<T> MatrixX<T>::upper(bool unit_diag) &&
+{
+    return TriangularView<T>(std::move(*this), Uplo::upper, unit_diag);
+}
+
+template<typename T>
+TriangularView<T> MatrixX<T>::lower(bool unit_diag) const&
+{
+    return TriangularView<T>(*this, Uplo::lower, unit_diag);
+}
+
+template<typename T>
+TriangularView<T> MatrixX<T>::lower(bool unit_diag) &&
+{
+    return TriangularView<T>(std::move(*this), Uplo::lower, unit_diag);
+}
+
+template<typename T>
+MatrixX<T> operator*(const MatrixX<T>& m, const TriangularView<T>& t)
+{
+    QS_ASSERT(m.col() == t.row());
+    const int n{t.row()};
+    MatrixX<T> out(m.row(), n);
+    T* po{out.data()};
+    for (int i = 0; i < m.row(); ++i) {
+        for (int j = 0; j < n; ++j) {
+            const auto a{m.at(i, j)};
+            const int c0{t.uplo() == Uplo::upper ? j : 0};
+            const int c1{t.uplo() == Uplo::upper ? n : j + 1};
+            for (int c = c0; c < c1; ++c) po[i * n + c] += a * t.at(j, c);
+        }
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator+(const MatrixX<T>& m, const TriangularView<T>& t)
+{
+    QS_ASSERT(m.row() == t.row() && m.col() == t.col());
+    MatrixX<T> out{m};
+    for (int r = 0; r < t.row(); ++r) {
+        const int c0{t.uplo() == Uplo::upper ? r : 0};
+        const int c1{t.uplo() == Uplo::upper ? t.col() : r + 1};
+        for (int c = c0; c < c1; ++c) out.at(r, c) += t.at(r, c);
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator+(const TriangularView<T>& t, const MatrixX<T>& m) { return m + t; }
+
+template<typename T>
+MatrixX<T> operator-(const MatrixX<T>& m, const TriangularView<T>& t)
+{
+    QS_ASSERT(m.row() == t.row() && m.col() == t.col());
+    MatrixX<T> out{m};
+    for (int r = 0; r < t.row(); ++r) {
+        const int c0{t.uplo() == Uplo::upper ? r : 0};
+        const int c1{t.uplo() == Uplo::upper ? t.col() : r + 1};
+        for (int c = c0; c < c1; ++c) out.at(r, c) -= t.at(r, c);
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator-(const TriangularView<T>& t, const MatrixX<T>& m) { return m * T{-1} + t; }
+
+template<typename T>
+SymmetricMatrix<T>::SymmetricMatrix(const MatrixX<T>& m)
+    : SymmetricMatrix(m.row())
+{
+    QS_ASSERT(m.row() == m.col());
+    T* p{data_.data()};
+    for (int r = 0; r < n_; ++r) {
+        for (int c = 0; c <= r; ++c) *p++ = m.at(r, c);
+    }
+}
+
+template<typename T>
+MatrixX<T> SymmetricMatrix<T>::to_dense() const
+{
+    MatrixX<T> out(n_, n_);
+    for (int r = 0; r < n_; ++r) {
+        for (int c = 0; c <= r; ++c) out.at(r, c) = out.at(c, r) = at(r, c);
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> SymmetricMatrix<T>::operator*(const MatrixX<T>& b) const
+{
+    // every packed entry below the diagonal contributes twice
+    QS_ASSERT(col() == b.row());
+    const int k{b.col()};
+    const T* pa{data_.data()};
+    const T* pb{b.data()};
+    MatrixX<T> out(n_, k);
+    T* po{out.data()};
+    for (int r = 0; r < n_; ++r) {
+        const T* ar{pa + r * (r + 1) / 2};
+        for (int c = 0; c < r; ++c) {
+            const auto a{ar[c]};
+            for (int j = 0; j < k; ++j) {
+                po[r * k + j] += a * pb[c * k + j];
+                po[c * k + j] += a * pb[r * k + j];
+            }
+        }
+        for (int j = 0; j < k; ++j) po[r * k + j] += ar[r] * pb[r * k + j];
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> SymmetricMatrix<T>::solve(const MatrixX<T>& b) const
+{
+    QS_ASSERT(b.row() == row());
+    // factor A = L D L^T in packed form, L unit lower, D on the diagonal
+    Array<T> f{data_};
+    T* pf{f.data()};
+    auto idx{[] (int r, int c) { return r * (r + 1) / 2 + c; }};
+    for (int j = 0; j < n_; ++j) {
+        T d{pf[idx(j, j)]};
+        for (int p = 0; p < j; ++p) d -= pf[idx(j, p)] * pf[idx(j, p)] * pf[idx(p, p)];
+        pf[idx(j, j)] = d;
+        for (int i = j + 1; i < n_; ++i) {
+            T v{pf[idx(i, j)]};
+            for (int p = 0; p < j; ++p) v -= pf[idx(i, p)] * pf[idx(j, p)] * pf[idx(p, p)];
+            pf[idx(i, j)] = v / d;
+        }
+    }
+
+    const int k{b.col()};
+    MatrixX<T> x{b};
+    T* px{x.data()};
+    for (int i = 0; i < n_; ++i) {
+        for (int p = 0; p < i; ++p) {
+            for (int c = 0; c < k; ++c) px[i * k + c] -= pf[idx(i, p)] * px[p * k + c];
+        }
+    }
+    for (int i = 0; i < n_; ++i) {
+        const auto d{1 / pf[idx(i, i)]};
+        for (int c = 0; c < k; ++c) px[i * k + c] *= d;
+    }
+    for (int i = n_ - 1; i >= 0; --i) {
+        for (int p = i + 1; p < n_; ++p) {
+            for (int c = 0; c < k; ++c) px[i * k + c] -= pf[idx(p, i)] * px[p * k + c];
+        }
+    }
+    return x;
+}
+
+template<typename T>
+SymmetricMatrix<T> SymmetricMatrix<T>::operator+(const SymmetricMatrix& other) const
+{
+    QS_ASSERT(n_ == other.n_);
+    SymmetricMatrix<T> out{*this};
+    out.data_ = data_ + other.data_;
+    return out;
+}
+
+template<typename T>
+SymmetricMatrix<T> SymmetricMatrix<T>::operator+(const DiagonalMatrix<T>& d) const
+{
+    QS_ASSERT(n_ == d.row());
+    SymmetricMatrix<T> out{*this};
+    for (int i = 0; i < n_; ++i) out.at(i, i) += d.at(i);
+    return out;
+}
+
+template<typename T>
+SymmetricMatrix<T> SymmetricMatrix<T>::operator*(T v) const
+{
+    SymmetricMatrix<T> out{*this};
+    out.data_ = data_ * v;
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator+(const MatrixX<T>& m, const SymmetricMatrix<T>& s)
+{
+    QS_ASSERT(m.row() == s.row() && m.col() == s.col());
+    MatrixX<T> out{m};
+    for (int r = 0; r < s.row(); ++r) {
+        for (int c = 0; c < s.col(); ++c) out.at(r, c) += s.at(r, c);
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator+(const SymmetricMatrix<T>& s, const MatrixX<T>& m) { return m + s; }
+
+template<typename T>
+MatrixX<T> operator-(const MatrixX<T>& m, const SymmetricMatrix<T>& s) { return m + s * T{-1}; }
+
+template<typename T>
+MatrixX<T> operator-(const SymmetricMatrix<T>& s, const MatrixX<T>& m) { return m * T{-1} + s; }
+
+// m * S = (S * m^T)^T as S is symmetric
+template<typename T>
+MatrixX<T> operator*(const MatrixX<T>& m, const SymmetricMatrix<T>& s)
+{
+    QS_ASSERT(m.col() == s.row());
+    return (s * m.t()).t();
+}
+
+template<typename T>
+SymmetricMatrix<T> operator*(T v, const SymmetricMatrix<T>& s) { return s * v; }
+
+template<typename T>
+BandedMatrix<T>::BandedMatrix(int n, int kl, int ku)
+    : data_(n * (kl + ku + 1))
+    , n_(n)
+    , kl_(kl)
+    , ku_(ku)
+{
+    QS_ASSERT(kl >= 0 && ku >= 0);
+}
+
+template<typename T>
+BandedMatrix<T>::BandedMatrix(const MatrixX<T>& m, int kl, int ku)
+    : BandedMatrix(m.row(), kl, ku)
+{
+    QS_ASSERT(m.row() == m.col());
+    for (int r = 0; r < n_; ++r) {
+        for (int c = std::max(0, r - kl_); c <= std::min(n_ - 1, r + ku_); ++c) at(r, c) = m.at(r, c);
+    }
+}
+
+template<typename T>
+MatrixX<T> BandedMatrix<T>::to_dense() const
+{
+    MatrixX<T> out(n_, n_);
+    for (int r = 0; r < n_; ++r) {
+        for (int c = std::max(0, r - kl_); c <= std::min(n_ - 1, r + ku_); ++c) out.at(r, c) = at(r, c);
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> BandedMatrix<T>::operator*(const MatrixX<T>& b) const
+{
+    QS_ASSERT(col() == b.row());
+    const int k{b.col()};
+    const int w{width()};
+    const T* pa{data_.data()};
+    const T* pb{b.data()};
+    MatrixX<T> out(n_, k);
+    T* po{out.data()};
+    for (int r = 0; r < n_; ++r) {
+        for (int c = std::max(0, r - kl_); c <= std::min(n_ - 1, r + ku_); ++c) {
+            const auto a{pa[r * w + c - r + kl_]};
+            for (int j = 0; j < k; ++j) po[r * k + j] += a * pb[c * k + j];
+        }
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> BandedMatrix<T>::solve(const MatrixX<T>& b) const
+{
+    QS_ASSERT(b.row() == row());
+    // row interchanges widen the upper band to kl + ku, the factors are kept
+    // in a band of kl sub and ku2 super diagonals
+    const int ku2{kl_ + ku_};
+    const int w{kl_ + ku2 + 1};
+    std::vector<T> lu(static_cast<std::size_t>(n_) * w);
+    std::vector<int> piv(n_);
+    auto a{[&] (int r, int c) -> T& { return lu[r * w + c - r + kl_]; }};
+    for (int r = 0; r < n_; ++r) {
+        for (int c = std::max(0, r - kl_); c <= std::min(n_ - 1, r + ku_); ++c) a(r, c) = at(r, c);
+    }
+
+    for (int k = 0; k < n_; ++k) {
+        const int last_r{std::min(n_ - 1, k + kl_)};
+        const int last_c{std::min(n_ - 1, k + ku2)};
+        int p{k};
+        for (int r = k + 1; r <= last_r; ++r) {
+            if (std::abs(a(r, k)) > std::abs(a(p, k))) p = r;
+        }
+        piv[k] = p;
+        if (p != k) {
+            for (int c = k; c <= last_c; ++c) std::swap(a(k, c), a(p, c));
+        }
+        const auto d{a(k, k)};
+        for (int r = k + 1; r <= last_r; ++r) {
+            const auto l{a(r, k) / d};
+            a(r, k) = l;
+            for (int c = k + 1; c <= last_c; ++c) a(r, c) -= l * a(k, c);
+        }
+    }
+
+    const int nrhs{b.col()};
+    MatrixX<T> x{b};
+    T* px{x.data()};
+    for (int k = 0; k < n_; ++k) {
+        if (piv[k] != k) std::swap_ranges(px + k * nrhs, px + (k + 1) * nrhs, px + piv[k] * nrhs);
+        for (int r = k + 1; r <= std::min(n_ - 1, k + kl_); ++r) {
+            const auto l{a(r, k)};
+            for (int c = 0; c < nrhs; ++c) px[r * nrhs + c] -= l * px[k * nrhs + c];
+        }
+    }
+    for (int r = n_ - 1; r >= 0; --r) {
+        for (int c = r + 1; c <= std::min(n_ - 1, r + ku2); ++c) {
+            const auto u{a(r, c)};
+            for (int j = 0; j < nrhs; ++j) px[r * nrhs + j] -= u * px[c * nrhs + j];
+        }
+        const auto d{1 / a(r, r)};
+        for (int j = 0; j < nrhs; ++j) px[r * nrhs + j] *= d;
+    }
+    return x;
+}
+
+template<typename T>
+BandedMatrix<T> BandedMatrix<T>::operator+(const BandedMatrix& other) const
+{
+    QS_ASSERT(n_ == other.n_);
+    BandedMatrix<T> out(n_, std::max(kl_, other.kl_), std::max(ku_, other.ku_));
+    for (int r = 0; r < n_; ++r) {
+        for (int c = std::max(0, r - out.kl_); c <= std::min(n_ - 1, r + out.ku_); ++c) {
+            out.at(r, c) = at(r, c) + other.at(r, c);
+        }
+    }
+    return out;
+}
+
+template<typename T>
+BandedMatrix<T> BandedMatrix<T>::operator+(const DiagonalMatrix<T>& d) const
+{
+    QS_ASSERT(n_ == d.row());
+    BandedMatrix<T> out{*this};
+    for (int i = 0; i < n_; ++i) out.at(i, i) += d.at(i);
+    return out;
+}
+
+template<typename T>
+BandedMatrix<T> BandedMatrix<T>::operator*(T v) const
+{
+    BandedMatrix<T> out{*this};
+    out.data_ = data_ * v;
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator+(const MatrixX<T>& m, const BandedMatrix<T>& b)
+{
+    QS_ASSERT(m.row() == b.row() && m.col() == b.col());
+    MatrixX<T> out{m};
+    for (int r = 0; r < b.row(); ++r) {
+        for (int c = std::max(0, r - b.kl()); c <= std::min(b.col() - 1, r + b.ku()); ++c) out.at(r, c) += b.at(r, c);
+    }
+    return out;
+}
+
+template<typename T>
+MatrixX<T> operator+(const BandedMatrix<T>& b, const MatrixX<T>& m) { return m + b; }
+
+template<typename T>
+MatrixX<T> operator-(const MatrixX<T>& m, const BandedMatrix<T>& b) { return m + b * T{-1}; }
+
+template<typename T>
+MatrixX<T> operator-(const BandedMatrix<T>& b, const MatrixX<T>& m) { return m * T{-1} + b; }
+
+template<typename T>
+MatrixX<T> operator*(const MatrixX<T>& m, const BandedMatrix<T>& b)
+{
+    QS_ASSERT(m.col() == b.row());
+    const int n{b.col()};
+    MatrixX<T> out(m.row(), n);
+    T* po{out.data()};
+    for (int i = 0; i < m.row(); ++i) {
+        for (int r = 0; r < b.row(); ++r) {
+            const auto a{m.at(i, r)};
+            for (int c = std::max(0, r - b.kl()); c <= std::min(n - 1, r + b.ku()); ++c) po[i * n + c] += a * b.at(r, c);
+        }
+    }
+    return out;
+}
+
+template<typename T>
+BandedMatrix<T> operator*(T v, const BandedMatrix<T>& b) { return b * v; }
+
+// Dense Cholesky factor A = L L^T of a symmetric positive definite matrix,
+// only the lower triangle of A is read. update_ and downdate_ turn the factor
+// into that of A ± V V^T in O(n^2 k) for an n x k V, instead of refactoring.
+template<typename T>
+struct Cholesky
+{
+    explicit Cholesky(const MatrixX<T>& a);
+
+    inline int row() const { return l_.row(); }
+    inline int col() const { return l_.col(); }
+    // false when A was not positive definite, the factor is then unusable
+    inline bool ok() const { return ok_; }
+    inline const MatrixX<T>& l() const { return l_; }
+
+    MatrixX<T> solve(const MatrixX<T>& b) const;
+    MatrixX<T> inv() const;
+    T det() const;
+    // A + V V^T, returns false and keeps the factor only when v holds
+    // non finite values
+    bool update_(const MatrixX<T>& v);
+    // A - V V^T, returns false and keeps the factor when that is not
+    // positive definite
+    bool downdate_(const MatrixX<T>& v);
+private:
+    // rank one update (sign 1) or downdate (sign -1) with x, x is clobbered
+    bool rank1_(T* x, T sign);
+    // one rank1_ per column of v, restores the factor when one fails
+    bool rank_k_(const MatrixX<T>& v, T sign);
+
+    MatrixX<T> l_;
+    bool ok_;
+}; // struct Cholesky
+
+// A = L D L^T without pivoting, L unit lower, for positive definite or
+// quasi-definite A. update_ gives the factor of A + alpha V V^T in O(n^2 k)
+// as long as the inertia of A, the signs of D, stays the same.
+template<typename T>
+struct LDLT
+{
+    explicit LDLT(const MatrixX<T>& a);
+
+    inline int row() const { return l_.row(); }
+    inline int col() const { return l_.col(); }
+    // false when a zero pivot showed up
+    inline bool ok() const { return ok_; }
+    inline const MatrixX<T>& l() const { return l_; }
+    inline const Array<T>& d() const { return d_; }
+
+    MatrixX<T> solve(const MatrixX<T>& b) const;
+    T det() const;
+    // A + alpha V V^T, returns false and keeps the factor when a pivot
+    // would vanish or change sign, e.g. a downdate of a positive definite A
+    // that loses definiteness
+    bool update_(const MatrixX<T>& v, T alpha = 1);
+    inline bool downdate_(const MatrixX<T>& v) { return update_(v, T{-1}); }
+private:
+    MatrixX<T> l_;
+    Array<T> d_;
+    bool ok_;
+}; // struct LDLT
+
+// Symmetric eigendecomposition A = Q diag(values) Q^T by cyclic Jacobi
+// rotations. Factoring is O(n^3), after that every diagonal shift
+// (A + sigma I)^-1 b costs O(n^2), e.g. when an ADMM penalty is retuned.
+template<typename T>
+struct SymmetricEigen
+{
+    explicit SymmetricEigen(const MatrixX<T>& a, int max_sweeps = 64);
+
+    inline const Array<T>& values() const { return values_; }
+    // eigenvectors are the columns
+    inline const MatrixX<T>& vectors() const { return q_; }
+
+    // (A + shift I)^-1 b
+    MatrixX<T> solve(const MatrixX<T>& b, T shift = 0) const;
+    // (A + shift I)^-1
+    MatrixX<T> inv(T shift = 0) const;
+private:
+    Array<T> values_;
+    MatrixX<T> q_;
+}; // struct SymmetricEigen
+
+template<typename T>
+Cholesky<T>::Cholesky(const MatrixX<T>& a)
+    : l_(a.row(), a.col())
+    , ok_(true)
+{
+    QS_ASSERT(a.row() == a.col());
+    const int n{a.row()};
+    const T* pa{a.data()};
+    T* pl{l_.data()};
+    std::fill(pl, pl + n * n, T{0});
+    for (int j = 0; j < n && ok_; ++j) {
+        T d{pa[j * n + j]};
+        for (int p = 0; p < j; ++p) d -= pl[j * n + p] * pl[j * n + p];
+        if (!(d > 0)) {
+            ok_ = false;
+            break;
+        }
+        d = std::sqrt(d);
+        pl[j * n + j] = d;
+        for (int i = j + 1; i < n; ++i) {
+            T v{pa[i * n + j]};
+            for (int p = 0; p < j; ++p) v -= pl[i * n + p] * pl[j * n + p];
+            pl[i * n + j] = v / d;
+        }
+    }
+}
+
+template<typename T>
+MatrixX<T> Cholesky<T>::solve(const MatrixX<T>& b) const
+{
+    QS_ASSERT(ok_ && b.row() == row());
+    const int n{row()};
+    const int k{b.col()};
+    const T* pl{l_.data()};
+    MatrixX<T> x{b};
+    T* px{x.data()};
+    for (int i = 0; i < n; ++i) {
+        for (int p = 0; p < i; ++p) {
+            for (int c = 0; c < k; ++c) px[i * k + c] -= pl[i * n + p] * px[p * k + c];
+        }
+        const auto d{1 / pl[i * n + i]};
+        for (int c = 0; c < k; ++c) px[i * k + c] *= d;
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        for (int p = i + 1; p < n; ++p) {
+            for (int c = 0; c < k; ++c) px[i * k + c] -= pl[p * n + i] * px[p * k + c];
+        }
+        const auto d{1 / pl[i * n + i]};
+        for (int c = 0; c < k; ++c) px[i * k + c] *= d;
+    }
+    return x;
+}
+
+template<typename T>
+MatrixX<T> Cholesky<T>::inv() const
+{
+    return solve(MatrixX<T>::eye(row()));
+}
+
+template<typename T>
+T Cholesky<T>::det() const
+{
+    T d{1};
+    for (int i = 0; i < row(); ++i) d *= l_(i, i) * l_(i, i);
+    return d;
+}
+
+template<typename T>
+bool Cholesky<T>::rank1_(T* x, T sign)
+{
+    // LINPACK style, one hyperbolic (downdate) or ordinary (update) rotation
+    // per column, L(k, k)^2 + sign x_k^2 must stay positive
+    const int n{row()};
+    T* pl{l_.data()};
+    for (int k = 0; k < n; ++k) {
+        const auto lkk{pl[k * n + k]};
+        const auto r2{lkk * lkk + sign * x[k] * x[k]};
+        if (!(r2 > 0)) return false;
+        const auto r{std::sqrt(r2)};
+        const auto c{r / lkk};
+        const auto s{x[k] / lkk};
+        pl[k * n + k] = r;
+        for (int i = k + 1; i < n; ++i) {
+            auto& lik{pl[i * n + k]};
+            lik = (lik + sign * s * x[i]) / c;
+            x[i] = c * x[i] - s * lik;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+bool Cholesky<T>::update_(const MatrixX<T>& v)
+{
+    return rank_k_(v, T{1});
+}
+
+template<typename T>
+bool Cholesky<T>::downdate_(const MatrixX<T>& v)
+{
+    return rank_k_(v, T{-1});
+}
+
+template<typename T>
+bool Cholesky<T>::rank_k_(const MatrixX<T>& v, T sign)
+{
+    QS_ASSERT(ok_ && v.row() == row());
+    MatrixX<T> saved{l_};
+    Array<T> x(row());
+    for (int j = 0; j < v.col(); ++j) {
+        for (int i = 0; i < row(); ++i) x.at(i) = v(i, j);
+        if (!rank1_(x.data(), sign)) {
+            l_ = std::move(saved);
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+LDLT<T>::LDLT(const MatrixX<T>& a)
+    : l_(MatrixX<T>::eye(a.row()))
+    , d_(a.row())
+    , ok_(true)
+{
+    QS_ASSERT(a.row() == a.col());
+    const int n{a.row()};
+    const T* pa{a.data()};
+    T* pl{l_.data()};
+    T* pd{d_.data()};
+    for (int j = 0; j < n; ++j) {
+        T d{pa[j * n + j]};
+        for (int p = 0; p < j; ++p) d -= pl[j * n + p] * pl[j * n + p] * pd[p];
+        if (d == 0) {
+            ok_ = false;
+            break;
+        }
+        pd[j] = d;
+        for (int i = j + 1; i < n; ++i) {
+            T v{pa[i * n + j]};
+            for (int p = 0; p < j; ++p) v -= pl[i * n + p] * pl[j * n + p] * pd[p];
+            pl[i * n + j] = v / d;
+        }
+    }
+}
+
+template<typename T>
+MatrixX<T> LDLT<T>::solve(const MatrixX<T>& b) const
+{
+    QS_ASSERT(ok_ && b.row() == row());
+    const int n{row()};
+    const int k{b.col()};
+    const T* pl{l_.data()};
+    MatrixX<T> x{b};
+    T* px{x.data()};
+    for (int i = 0; i < n; ++i) {
+        for (int p = 0; p < i; ++p) {
+            for (int c = 0; c < k; ++c) px[i * k + c] -= pl[i * n + p] * px[p * k + c];
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        const auto d{1 / d_.at(i)};
+        for (int c = 0; c < k; ++c) px[i * k + c] *= d;
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        for (int p = i + 1; p < n; ++p) {
+            for (int c = 0; c < k; ++c) px[i * k + c] -= pl[p * n + i] * px[p * k + c];
+        }
+    }
+    return x;
+}
+
+template<typename T>
+T LDLT<T>::det() const
+{
+    T d{1};
+    for (int i = 0; i < d_.size(); ++i) d *= d_.at(i);
+    return d;
+}
+
+template<typename T>
+bool LDLT<T>::update_(const MatrixX<T>& v, T alpha)
+{
+    // Gill, Golub, Murray and Saunders, "Methods for modifying matrix
+    // factorizations", method C1, one column of V at a time
+    QS_ASSERT(ok_ && v.row() == row());
+    const int n{row()};
+    MatrixX<T> saved_l{l_};
+    Array<T> saved_d{d_};
+    Array<T> w(n);
+    T* pl{l_.data()};
+    T* pd{d_.data()};
+    for (int j = 0; j < v.col(); ++j) {
+        for (int i = 0; i < n; ++i) w.at(i) = v(i, j);
+        T* pw{w.data()};
+        T a{alpha};
+        for (int k = 0; k < n; ++k) {
+            const auto p{pw[k]};
+            const auto d{pd[k] + a * p * p};
+            if (!(d > 0 && pd[k] > 0) && !(d < 0 && pd[k] < 0)) {
+                l_ = std::move(saved_l);
+                d_ = std::move(saved_d);
+                return false;
+            }
+            const auto beta{p * a / d};
+            a = pd[k] * a / d;
+            pd[k] = d;
+            for (int i = k + 1; i < n; ++i) {
+                pw[i] -= p * pl[i * n + k];
+                pl[i * n + k] += beta * pw[i];
+            }
+        }
+    }
+    return true;
+}
+
+template<typename T>
+SymmetricEigen<T>::SymmetricEigen(const MatrixX<T>& a, int max_sweeps)
+    : values_(a.row())
+    , q_(MatrixX<T>::eye(a.row()))
+{
+    QS_ASSERT(a.row() == a.col());
+    const int n{a.row()};
+    MatrixX<T> m{a};
+    T* pm{m.data()};
+    T* pq{q_.data()};
+
+    T scale{0};
+    for (int i = 0; i < n * n; ++i) scale += pm[i] * pm[i];
+    const auto tol{std::numeric_limits<T>::epsilon() * std::numeric_limits<T>::epsilon() * scale};
+    for (int sweep = 0; sweep < max_sweeps; ++sweep) {
+        T off{0};
+        for (int p = 0; p < n; ++p) {
+            for (int q = p + 1; q < n; ++q) off += pm[p * n + q] * pm[p * n + q];
+        }
+        if (off <= tol) break;
+
+        for (int p = 0; p < n; ++p) {
+            for (int q = p + 1; q < n; ++q) {
+                const auto apq{pm[p * n + q]};
+                if (apq == 0) continue;
+                // rotation zeroing m(p, q), the smaller of the two angles
+                const auto theta{(pm[q * n + q] - pm[p * n + p]) / (2 * apq)};
+                const auto t{(theta >= 0 ? T{1} : T{-1}) / (std::abs(theta) + std::sqrt(theta * theta + 1))};
+                const auto c{1 / std::sqrt(t * t + 1)};
+                const auto s{t * c};
+                for (int k = 0; k < n; ++k) {
+                    const auto mkp{pm[k * n + p]};
+                    const auto mkq{pm[k * n + q]};
+                    pm[k * n + p] = c * mkp - s * mkq;
+                    pm[k * n + q] = s * mkp + c * mkq;
+                }
+                for (int k = 0; k < n; ++k) {
+                    const auto mpk{pm[p * n + k]};
+                    const auto mqk{pm[q * n + k]};
+                    pm[p * n + k] = c * mpk - s * mqk;
+                    pm[q * n + k] = s * mpk + c * mqk;
+                }
+                for (int k = 0; k < n; ++k) {
+                    const auto qkp{pq[k * n + p]};
+                    const auto qkq{pq[k * n + q]};
+                    pq[k * n + p] = c * qkp - s * qkq;
+                    pq[k * n + q] = s * qkp + c * qkq;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < n; ++i) values_.at(i) = pm[i * n + i];
+}
+
+template<typename T>
+MatrixX<T> SymmetricEigen<T>::solve(const MatrixX<T>& b, T shift) const
+{
+    QS_ASSERT(b.row() == q_.row());
+    const int n{q_.row()};
+    const int k{b.col()};
+    // x = Q diag(1 / (values + shift)) Q^T b
+    MatrixX<T> y(n, k);
+    y.fill_0_();
+    const T* pq{q_.data()};
+    const T* pb{b.data()};
+    T* py{y.data()};
+    for (int r = 0; r < n; ++r) {
+        for (int i = 0; i < n; ++i) {
+            for (int c = 0; c < k; ++c) py[i * k + c] += pq[r * n + i] * pb[r * k + c];
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        const auto d{1 / (values_.at(i) + shift)};
+        for (int c = 0; c < k; ++c) py[i * k + c] *= d;
+    }
+    MatrixX<T> x(n, k);
+    x.fill_0_();
+    detail::gemm(pq, py, x.data(), n, n, k);
+    return x;
+}
+
+template<typename T>
+MatrixX<T> SymmetricEigen<T>::inv(T shift) const
+{
+    return solve(MatrixX<T>::eye(q_.row()), shift);
+}
+
+// a_inv <- (A + u v^T)^-1 given a_inv = A^-1, in O(n^2). Returns false and
+// leaves a_inv alone when 1 + v^T A^-1 u vanishes (the update is singular).
+template<typename T>
+bool sherman_morrison_(MatrixX<T>& a_inv, const MatrixX<T>& u, const MatrixX<T>& v)
+{
+    const int n{a_inv.row()};
+    QS_ASSERT(a_inv.col() == n && u.size() == n && v.size() == n);
+    T* pa{a_inv.data()};
+    // z = A^-1 u, w = A^-T v
+    Array<T> z(n), w(n);
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c < n; ++c) {
+            z.at(r) += pa[r * n + c] * u.at(c);
+            w.at(c) += v.at(r) * pa[r * n + c];
+        }
+    }
+    T denom{1};
+    for (int i = 0; i < n; ++i) denom += v.at(i) * z.at(i);
+    if (std::abs(denom) <= std::numeric_limits<T>::epsilon()) return false;
+    for (int r = 0; r < n; ++r) {
+        const auto s{z.at(r) / denom};
+        for (int c = 0; c < n; ++c) pa[r * n + c] -= s * w.at(c);
+    }
+    return true;
+}
+
+// a_inv <- (A + U C V^T)^-1 given a_inv = A^-1, U and V are n x k and C is
+// k x k, in O(n^2 k + k^3). The capacitance C^-1 + V^T A^-1 U must be
+// invertible.
+template<typename T>
+void woodbury_(MatrixX<T>& a_inv, const MatrixX<T>& u, const MatrixX<T>& c, const MatrixX<T>& v)
+{
+    QS_ASSERT(u.row() == a_inv.row() && v.row() == a_inv.row() && u.col() == v.col());
+    QS_ASSERT(c.row() == u.col() && c.col() == u.col());
+    const auto z{a_inv * u};
+    const auto vt{v.t()};
+    const auto w{vt * a_inv};
+    const auto s{(c.inv() + vt * z).inv()};
+    a_inv = a_inv - z * (s * w);
+}
+
+// C = I
+template<typename T>
+void woodbury_(MatrixX<T>& a_inv, const MatrixX<T>& u, const MatrixX<T>& v)
+{
+    woodbury_(a_inv, u, MatrixX<T>::eye(u.col()), v);
+}
+
+// Solve (A + U V^T) x = b with a factorization of A, anything with a
+// `solve(const MatrixX<T>&)` member (Cholesky, LDLT, SymmetricMatrix,
+// BandedMatrix). Costs k + 1 solves with A and a k x k inverse.
+template<typename S, typename T>
+MatrixX<T> woodbury_solve(const S& a, const MatrixX<T>& u, const MatrixX<T>& v, const MatrixX<T>& b)
+{
+    QS_ASSERT(u.row() == b.row() && v.row() == b.row() && u.col() == v.col());
+    const auto y{a.solve(b)};
+    const auto z{a.solve(u)};
+    const auto vt{v.t()};
+    const auto s{MatrixX<T>::eye(u.col()) + vt * z};
+    return y - z * (s.inv() * (vt * y));
+}
+
+// Proximal operators and Euclidean projections for first order methods.
+// Each one updates its argument in place in a single fused pass (two for the
+// norm based ones), the loops are branch free so they vectorize.
+namespace prox {
+
+// sign(x) * max(|x| - t, 0)
+template<typename T>
+void soft_threshold_(T* x, int n, T t)
+{
+    for (int i = 0; i < n; ++i) x[i] -= std::clamp(x[i], -t, t);
+}
+
+// prox of l1 |x| + l2 / 2 x^2, pass t * l1 and t * l2 for a step size t
+template<typename T>
+void elastic_net_(T* x, int n, T l1, T l2)
+{
+    const T s{1 / (1 + l2)};
+    for (int i = 0; i < n; ++i) x[i] = (x[i] - std::clamp(x[i], -l1, l1)) * s;
+}
+
+// projection onto [lo, hi]
+template<typename T>
+void box_(T* x, int n, T lo, T hi)
+{
+    for (int i = 0; i < n; ++i) x[i] = std::clamp(x[i], lo, hi);
+}
+
+// projection onto x >= 0
+template<typename T>
+void nonneg_(T* x, int n)
+{
+    for (int i = 0; i < n; ++i) x[i] = std::max(x[i], T{0});
+}
+
+// projection onto {‖x‖₂ <= radius}
+template<typename T>
+void l2_ball_(T* x, int n, T radius)
+{
+    T ss{0};
+    for (int i = 0; i < n; ++i) ss += x[i] * x[i];
+    const auto norm{std::sqrt(ss)};
+    if (norm <= radius) return;
+    const auto s{radius / norm};
+    for (int i = 0; i < n; ++i) x[i] *= s;
+}
+
+// projection onto the simplex {x >= 0, sum x = z}: find the threshold tau
+// with sum max(x - tau, 0) = z by Michelot's fixed point iteration, which
+// only ever raises tau and needs no sort or scratch memory
+template<typename T>
+void simplex_(T* x, int n, T z = 1)
+{
+    // z > 0 keeps at least one entry above tau, so k never drops to 0
+    QS_ASSERT(n > 0 && z > 0);
+    T sum{0};
+    for (int i = 0; i < n; ++i) sum += x[i];
+    T tau{(sum - z) / n};
+    while (true) {
+        T s{0};
+        int k{0};
+        for (int i = 0; i < n; ++i) {
+            const bool active{x[i] > tau};
+            s += active ? x[i] : T{0};
+            k += active;
+        }
+        const T next{(s - z) / k};
+        if (next <= tau) break;
+        tau = next;
+    }
+    for (int i = 0; i < n; ++i) x[i] = std::max(x[i] - tau, T{0});
+}
+
+// block soft threshold of consecutive groups of group_size elements,
+// x_g * max(0, 1 - t / ‖x_g‖₂)
+template<typename T>
+void group_lasso_(T* x, int n, int group_size, T t)
+{
+    QS_ASSERT(group_size > 0 && n % group_size == 0);
+    for (int g = 0; g < n; g += group_size) {
+        T ss{0};
+        for (int i = g; i < g + group_size; ++i) ss += x[i] * x[i];
+        const auto norm{std::sqrt(ss)};
+        const auto s{norm > t ? 1 - t / norm : T{0}};
+        for (int i = g; i < g + group_size; ++i) x[i] *= s;
+    }
+}
+
+template<typename T>
+void soft_threshold_(Array<T>& x, T t) { soft_threshold_(x.data(), x.size(), t); }
+template<typename T>
+void soft_threshold_(MatrixX<T>& x, T t) { soft_threshold_(x.array(), t); }
+template<typename T>
+void elastic_net_(Array<T>& x, T l1, T l2) { elastic_net_(x.data(), x.size(), l1, l2); }
+template<typename T>
+void elastic_net_(MatrixX<T>& x, T l1, T l2) { elastic_net_(x.array(), l1, l2); }
+template<typename T>
+void box_(Array<T>& x, T lo, T hi) { box_(x.data(), x.size(), lo, hi); }
+template<typename T>
+void box_(MatrixX<T>& x, T lo, T hi) { box_(x.array(), lo, hi); }
+template<typename T>
+void nonneg_(Array<T>& x) { nonneg_(x.data(), x.size()); }
+template<typename T>
+void nonneg_(MatrixX<T>& x) { nonneg_(x.array()); }
+template<typename T>
+void l2_ball_(Array<T>& x, T radius) { l2_ball_(x.data(), x.size(), radius); }
+template<typename T>
+void l2_ball_(MatrixX<T>& x, T radius) { l2_ball_(x.array(), radius); }
+template<typename T>
+void simplex_(Array<T>& x, T z = 1) { simplex_(x.data(), x.size(), z); }
+template<typename T>
+void simplex_(MatrixX<T>& x, T z = 1) { simplex_(x.array(), z); }
+template<typename T>
+void group_lasso_(Array<T>& x, int group_size, T t) { group_lasso_(x.data(), x.size(), group_size, t); }
+// every row of x is one group
+template<typename T>
+void group_lasso_(MatrixX<T>& x, T t) { group_lasso_(x.array(), x.col(), t); }
+
+// views are processed row by row, rows with a unit column stride go through
+// the contiguous kernels
+template<typename T, typename F>
+void for_each_row_(const MatrixRef<T>& x, F&& fn)
+{
+    for (int r = 0; r < x.row(); ++r) {
+        if (x.col_stride() == 1) {
+            fn(x.row_data(r), x.col());
+        } else {
+            for (int c = 0; c < x.col(); ++c) fn(&x.at(r, c), 1);
+        }
+    }
+}
+
+template<typename T>
+void soft_threshold_(const MatrixRef<T>& x, T t) { for_each_row_(x, [=] (T* p, int n) { soft_threshold_(p, n, t); }); }
+template<typename T>
+void elastic_net_(const MatrixRef<T>& x, T l1, T l2) { for_each_row_(x, [=] (T* p, int n) { elastic_net_(p, n, l1, l2); }); }
+template<typename T>
+void box_(const MatrixRef<T>& x, T lo, T hi) { for_each_row_(x, [=] (T* p, int n) { box_(p, n, lo, hi); }); }
+template<typename T>
+void nonneg_(const MatrixRef<T>& x) { for_each_row_(x, [] (T* p, int n) { nonneg_(p, n); }); }
+
+} // namespace prox
+
+using MatrixXi8 = MatrixX<std::int8_t>;
+using MatrixXu8 = MatrixX<std::uint8_t>;
+using MatrixXi16 = MatrixX<std::int16_t>;
+
+// Low precision matrix plus one dequantization scale per row or per column,
+// value = data * scale
+template<typename Q>
+struct QuantizedMatrix
+{
+    MatrixX<Q> data;
+    std::vector<float> scale;
+    bool per_row;
+}; // struct QuantizedMatrix
+
+namespace detail {
+
+#if defined(__AVX2__)
+inline std::int32_t hsum_epi32(__m256i v)
+{
+    const auto sum4{_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1))};
+    const auto sum2{_mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, 0x4e))};
+    const auto sum1{_mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, 0xb1))};
+    return _mm_cvtsi128_si32(sum1);
+}
+#endif
+
+#if defined(__AVX512F__) && defined(__AVX2__)
+// _mm512_reduce_add_epi32, the 512 to 256 cast and the unmasked extract all
+// trip a GCC 12 -Wuninitialized false positive, the zero masked extracts do
+// not
+inline std::int32_t hsum_epi32(__m512i v)
+{
+    return hsum_epi32(_mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xff, v, 0), _mm512_maskz_extracti64x4_epi64(0xff, v, 1)));
+}
+#endif
+
+#if defined(__AVX512BW__)
+// widen 32 bytes to int16, zero or sign extended by the element type
+template<typename T>
+inline __m512i widen512_epi16(const T* p)
+{
+    const auto r{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))};
+    if constexpr (std::is_unsigned_v<T>) return _mm512_cvtepu8_epi16(r);
+    else return _mm512_cvtepi8_epi16(r);
+}
+#endif
+
+#if defined(__AVX2__)
+template<typename T>
+inline __m256i widen256_epi16(const T* p)
+{
+    const auto r{_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))};
+    if constexpr (std::is_unsigned_v<T>) return _mm256_cvtepu8_epi16(r);
+    else return _mm256_cvtepi8_epi16(r);
+}
+#endif
+
+// sum a[i] * b[i] accumulated in int32, for any mix of u8 and i8 and for
+// (i16, i16). 16-bit products are summed in int32 as well, longer rows of
+// large int16 values overflow.
+template<typename A, typename B>
+std::int32_t dot_i32(const A* a, const B* b, int n)
+{
+    static_assert(sizeof(A) == sizeof(B) && sizeof(A) <= 2);
+    static_assert(sizeof(A) == 1 || (std::is_same_v<A, std::int16_t> && std::is_same_v<B, std::int16_t>));
+    int i{0};
+    std::int32_t result{0};
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+    if constexpr (std::is_same_v<A, std::uint8_t> && std::is_same_v<B, std::int8_t>) {
+        __m512i acc{_mm512_setzero_si512()};
+        for (; i + 64 <= n; i += 64) {
+            acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        }
+        result += hsum_epi32(acc);
+    } else if constexpr (sizeof(A) == 1) {
+        __m512i acc{_mm512_setzero_si512()};
+        for (; i + 32 <= n; i += 32) {
+            acc = _mm512_dpwssd_epi32(acc, widen512_epi16(a + i), widen512_epi16(b + i));
+        }
+        result += hsum_epi32(acc);
+    } else {
+        __m512i acc{_mm512_setzero_si512()};
+        for (; i + 32 <= n; i += 32) {
+            acc = _mm512_dpwssd_epi32(acc, _mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        }
+        result += hsum_epi32(acc);
+    }
+#elif defined(__AVX2__)
+    // widen to int16 and use pmaddwd, unlike pmaddubsw it cannot saturate
+    __m256i acc{_mm256_setzero_si256()};
+    if constexpr (sizeof(A) == 1) {
+        for (; i + 16 <= n; i += 16) {
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(widen256_epi16(a + i), widen256_epi16(b + i)));
+        }
+    } else {
+        for (; i + 16 <= n; i += 16) {
+            const auto va{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i))};
+            const auto vb{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))};
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+        }
+    }
+    result += hsum_epi32(acc);
+#endif
+    for (; i < n; ++i) {
+        result += static_cast<std::int32_t>(a[i]) * static_cast<std::int32_t>(b[i]);
+    }
+    return result;
+}
+
+} // namespace detail
+
+// c = a * b with int32 accumulation. Sums of int16 products wrap once they
+// leave the int32 range, keep k * max|a| * max|b| below 2^31.
+template<typename A, typename B>
+MatrixXi qgemm(const MatrixX<A>& a, const MatrixX<B>& b)
+{
+    QS_ASSERT(a.col() == b.row());
+    const auto k{a.col()};
+
+    // pack b column major so every output is a contiguous dot product
+    std::vector<B> bt(static_cast<std::size_t>(b.size()));
+    for (int r = 0; r < b.row(); ++r) {
+        for (int c = 0; c < b.col(); ++c) bt[c * k + r] = b.at(r, c);
+    }
+
+    MatrixXi out(a.row(), b.col());
+    const A* pa{a.data()};
+    for (int r = 0; r < out.row(); ++r) {
+        for (int c = 0; c < out.col(); ++c) {
+            out.at(r, c) = detail::dot_i32(pa + r * k, bt.data() + c * k, k);
+        }
+    }
+    return out;
+}
+
+// y = a * x with int32 accumulation, x is a column vector
+template<typename A, typename B>
+MatrixXi qgemv(const MatrixX<A>& a, const MatrixX<B>& x)
+{
+    QS_ASSERT(a.col() == x.row() && x.col() == 1);
+    const auto k{a.col()};
+    MatrixXi out(a.row(), 1);
+    const A* pa{a.data()};
+    const B* px{x.data()};
+    for (int r = 0; r < out.row(); ++r) {
+        out.at(r) = detail::dot_i32(pa + r * k, px, k);
+    }
+    return out;
+}
 
-    static Matrix<T, R, C> eye();
-    static Matrix<T, R, C> rand();
-    static Matrix<T, R, C> ones();
-    static Matrix<T, R, C> zeros();
-}; // struct Matrix
+// Symmetric quantization with one scale per row (per_row) or column, the
+// largest magnitude maps onto the largest value of Q. Unsigned types only
+// represent non-negative inputs, negative values are clamped to 0.
+template<typename Q>
+QuantizedMatrix<Q> quantize(const MatrixXf& m, bool per_row)
+{
+    static_assert(std::is_integral_v<Q>);
+    constexpr float qmax{static_cast<float>(std::numeric_limits<Q>::max())};
+    constexpr float qmin{std::is_signed_v<Q> ? -qmax : 0.0f};
+    const auto groups{per_row ? m.row() : m.col()};
+    const auto len{per_row ? m.col() : m.row()};
+    auto at{[&] (int g, int i) { return per_row ? m.at(g, i) : m.at(i, g); }};
 
-template<int R, int C>
-using Matrixd = Matrix<double, R, C>;
-template<int R, int C>
-using Matrixf = Matrix<float, R, C>;
-template<int R, int C>
-using Matrixi = Matrix<int, R, C>;
+    QuantizedMatrix<Q> out{MatrixX<Q>(m.row(), m.col()), std::vector<float>(groups), per_row};
+    for (int g = 0; g < groups; ++g) {
+        float amax{0};
+        for (int i = 0; i < len; ++i) amax = std::max(amax, std::abs(at(g, i)));
+        const auto scale{amax > 0 ? amax / qmax : 1.0f};
+        out.scale[g] = scale;
+        for (int i = 0; i < len; ++i) {
+            const auto q{static_cast<Q>(std::clamp(std::nearbyint(at(g, i) / scale), qmin, qmax))};
+            if (per_row) out.data.at(g, i) = q; else out.data.at(i, g) = q;
+        }
+    }
+    return out;
+}
 
-template<typename T, int DIM>
-using Vector = Matrix<T, DIM, 1>;
-template<int DIM>
-using Vectorf = Vector<float, DIM>;
-template<int DIM>
-using Vectord = Vector<double, DIM>;
-template<int DIM>
-using Vectori = Vector<int, DIM>;
+// out(r, c) = acc(r, c) * row_scale[r] * col_scale[c]
+inline MatrixXf dequantize(const MatrixXi& acc, const std::vector<float>& row_scale,
+                           const std::vector<float>& col_scale)
+{
+    QS_ASSERT(static_cast<int>(row_scale.size()) == acc.row());
+    QS_ASSERT(static_cast<int>(col_scale.size()) == acc.col());
+    MatrixXf out(acc.row(), acc.col());
+    for (int r = 0; r < acc.row(); ++r) {
+        for (int c = 0; c < acc.col(); ++c) {
+            out.at(r, c) = static_cast<float>(acc.at(r, c)) * row_scale[r] * col_scale[c];
+        }
+    }
+    return out;
+}
 
-template<typename T, int R, int C>
-Matrix<T, R, C>::Matrix(const MatrixX<T>& other)
-    : MatrixX<T>(other)
-{}
+// a quantized per row times b quantized per column, dequantized to float
+template<typename A, typename B>
+MatrixXf qgemm(const QuantizedMatrix<A>& a, const QuantizedMatrix<B>& b)
+{
+    QS_ASSERT(a.per_row && !b.per_row);
+    return dequantize(qgemm(a.data, b.data), a.scale, b.scale);
+}
 
-template<typename T, int R, int C>
-Matrix<T, R, C>::Matrix(MatrixX<T>&& other)
-    : MatrixX<T>(std::move(other))
-{}
+using MatrixXf16 = MatrixX<fp16>;
+using MatrixXbf16 = MatrixX<bf16>;
 
-template<typename T, int R, int C>
-Matrix<T, R, C>& Matrix<T, R, C>::operator=(const MatrixX<T>& other)
+// Element type conversion with the bulk (SIMD) kernels between float and
+// the 16 bit types, elementwise casts otherwise.
+template<typename To, typename From>
+MatrixX<To> convert(const MatrixX<From>& m)
 {
-    assert(R == other.row() && C == other.col());
-    this->array_ = other.array_;
-    return *this;
+    MatrixX<To> out(m.row(), m.col(), uninitialized);
+    if constexpr (std::is_same_v<From, float> && is_float16_v<To>) {
+        detail::from_float(m.data(), out.data(), m.size());
+    } else if constexpr (is_float16_v<From> && std::is_same_v<To, float>) {
+        detail::to_float(m.data(), out.data(), m.size());
+    } else {
+        std::transform(m.data(), m.data() + m.size(), out.data(), [] (From v) { return static_cast<To>(v); });
+    }
+    return out;
 }
 
-template<typename T, int R, int C>
-Matrix<T, R, C>& Matrix<T, R, C>::operator=(MatrixX<T>&& other)
+// y = a * x with a stored in 16 bits, float accumulation. a is streamed
+// once, which is what bounds a large gemv.
+template<typename F>
+MatrixXf gemv(const MatrixX<Float16<F>>& a, const MatrixXf& x)
 {
-    assert(R == other.row() && C == other.col());
-    this->array_ = std::move(other.array());
-    return *this;
+    QS_ASSERT(a.col() == x.row() && x.col() == 1);
+    const auto k{a.col()};
+    MatrixXf out(a.row(), 1);
+    const auto* pa{a.data()};
+    const float* px{x.data()};
+    float* po{out.data()};
+    parallel_for(a.row(), std::max(1, (1 << 16) / std::max(1, k)), [&] (int r0, int r1) {
+        for (int r = r0; r < r1; ++r) po[r] = detail::dot_f32(pa + static_cast<std::ptrdiff_t>(r) * k, px, k);
+    });
+    return out;
 }
 
-template<typename T, int R, int C>
-Matrix<T, R, C>::Matrix(const Array<T>& other)
-    : MatrixX<T>(R, C, other)
-{}
+struct Arena
+{
+    explicit Arena(std::size_t chunk_bytes = 1 << 16);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
 
-template<typename T, int R, int C>
-Matrix<T, R, C>::Matrix(Array<T>&& other)
-    : MatrixX<T>(R, C, std::move(other))
+    template<typename U>
+    U* alloc(int n);
+    template<typename U>
+    U* alloc_0(int n);
+    void reset();
+    inline std::size_t used() const { return used_; }
+    inline std::size_t capacity() const { return capacity_; }
+private:
+    struct Chunk
+    {
+        std::unique_ptr<char[]> mem;
+        std::size_t size;
+    }; // struct Chunk
+
+    static constexpr std::size_t align_ = 64;
+
+    std::vector<Chunk> chunks_;
+    std::size_t chunk_bytes_;
+    std::size_t chunk_;
+    std::size_t offset_;
+    std::size_t used_;
+    std::size_t capacity_;
+}; // struct Arena
+
+inline Arena::Arena(std::size_t chunk_bytes)
+    : chunk_bytes_(chunk_bytes)
+    , chunk_(0)
+    , offset_(0)
+    , used_(0)
+    , capacity_(0)
 {}
 
-template<typename T, int R, int C>
-Matrix<T, R, C>& Matrix<T, R, C>::operator=(const Array<T>& other)
+template<typename U>
+U* Arena::alloc(int n)
 {
-    assert(R * C == other.size());
-    this->array_ = other;
-    return *this;
+    static_assert(alignof(U) <= align_);
+    const std::size_t bytes{sizeof(U) * static_cast<std::size_t>(n)};
+
+    // bump allocation in the current chunk, moving on to the next one (or a
+    // new one) when it does not fit; chunks are kept across reset()
+    while (chunk_ < chunks_.size()) {
+        auto& chunk{chunks_[chunk_]};
+        const auto base{reinterpret_cast<std::uintptr_t>(chunk.mem.get())};
+        const auto begin{(base + offset_ + align_ - 1) & ~(align_ - 1)};
+        if (begin + bytes <= base + chunk.size) {
+            offset_ = begin + bytes - base;
+            used_ += bytes;
+            return reinterpret_cast<U*>(begin);
+        }
+        ++chunk_;
+        offset_ = 0;
+    }
+
+    const auto size{std::max(chunk_bytes_, bytes + align_)};
+    chunks_.push_back(Chunk{std::unique_ptr<char[]>(new char[size]), size});
+    capacity_ += size;
+    chunk_ = chunks_.size() - 1;
+    offset_ = 0;
+    return alloc<U>(n);
 }
 
-template<typename T, int R, int C>
-Matrix<T, R, C>& Matrix<T, R, C>::operator=(Array<T>&& other)
+template<typename U>
+U* Arena::alloc_0(int n)
 {
-    assert(R * C == other.size());
-    this->array_ = std::move(other);
-    return *this;
+    auto p{alloc<U>(n)};
+    std::fill(p, p + n, U{0});
+    return p;
 }
 
-template<typename T, int R, int C>
-Matrix<T, R, C> Matrix<T, R, C>::eye()
+inline void Arena::reset()
 {
-    static_assert(R == C);
-    Matrix<T, R, C> m;
-    m.eye_();
-    return m;
+    chunk_ = 0;
+    offset_ = 0;
+    used_ = 0;
 }
 
-template<typename T, int R, int C>
-Matrix<T, R, C> Matrix<T, R, C>::rand()
+struct SolveOptions
 {
-    Matrix<T, R, C> m;
-    m.fill_rand_();
-    return m;
-}
+    // 0 uses num_threads()
+    int threads{0};
+    // no task starts after the deadline, running ones see it in their token
+    StopToken::clock::time_point deadline{StopToken::clock::time_point::max()};
+    // per task time budget, zero for none
+    StopToken::clock::duration task_budget{0};
+    // external cancellation, may be null
+    const StopToken* stop{nullptr};
+    // chunk size of the per worker scratch arenas
+    std::size_t arena_bytes{1 << 16};
+}; // struct SolveOptions
 
-template<typename T, int R, int C>
-Matrix<T, R, C> Matrix<T, R, C>::ones()
+struct SolveResult
 {
-    Matrix<T, R, C> m;
-    m.fill_1_();
-    return m;
-}
+    // tasks that ran, including ones that returned early on a stop
+    int done;
+    // tasks never started because of a cancel or the deadline
+    int skipped;
+}; // struct SolveResult
 
-template<typename T, int R, int C>
-Matrix<T, R, C> Matrix<T, R, C>::zeros()
+template<typename F>
+SolveResult parallel_solve(int n, F&& fn, const SolveOptions& opt = SolveOptions{});
+
+// Passed to every task of parallel_solve. The arena belongs to the worker and
+// is reset before each task, the token fires on cancel(), on an external
+// stop, on the batch deadline or when the task runs past its budget.
+struct SolveContext
 {
-    Matrix<T, R, C> m;
-    m.fill_0_();
-    return m;
+    inline int index() const { return index_; }
+    inline int worker() const { return worker_; }
+    inline Arena& arena() const { return arena_; }
+    inline const StopToken& token() const { return token_; }
+    inline bool stop_requested() const { return token_.stop_requested(); }
+    // stop the whole batch, tasks not started yet are skipped
+    inline void cancel() const { batch_.request_stop(); }
+private:
+    template<typename F>
+    friend SolveResult parallel_solve(int n, F&& fn, const SolveOptions& opt);
+
+    SolveContext(int index, int worker, Arena& arena, const StopToken& token, StopToken& batch)
+        : index_(index), worker_(worker), arena_(arena), token_(token), batch_(batch)
+    {}
+
+    int index_;
+    int worker_;
+    Arena& arena_;
+    const StopToken& token_;
+    StopToken& batch_;
+}; // struct SolveContext
+
+namespace detail {
+
+// Pending tasks of one worker, a contiguous index range. The owner pops from
+// the front, a thief splits off the back half, so one steal moves many tasks
+// and neighbouring tasks tend to stay on one worker.
+struct alignas(64) TaskRange
+{
+    std::mutex m;
+    int begin{0};
+    int end{0};
+
+    bool pop(int& i)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        if (begin >= end) return false;
+        i = begin++;
+        return true;
+    }
+
+    bool steal(int& b, int& e)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        if (begin >= end) return false;
+        b = begin + (end - begin) / 2;
+        e = end;
+        end = b;
+        return true;
+    }
+}; // struct TaskRange
+
+} // namespace detail
+
+// Run fn(i, ctx) for every i in [0, n) on a work stealing pool. Meant for
+// batches of independent problems of uneven cost: each worker starts on a
+// contiguous share and steals half of a busy worker's remaining range once
+// its own runs dry. Tasks get a per worker scratch arena and a stop token
+// (see SolveContext), tasks not started when a stop fires are skipped and
+// counted. The first exception thrown by a task cancels the batch and is
+// rethrown from the calling thread. Inside a task num_threads() is 1, so
+// gemm and the other parallel kernels run serially instead of starting
+// threads of their own on top of the pool.
+template<typename F>
+SolveResult parallel_solve(int n, F&& fn, const SolveOptions& opt)
+{
+    using clock = StopToken::clock;
+    const auto workers{std::max(1, std::min(n, opt.threads > 0 ? opt.threads : num_threads()))};
+
+    StopToken batch(opt.deadline, opt.stop);
+    std::unique_ptr<detail::TaskRange[]> ranges(new detail::TaskRange[workers]);
+    for (int w = 0; w < workers; ++w) {
+        ranges[w].begin = static_cast<int>(static_cast<std::int64_t>(n) * w / workers);
+        ranges[w].end = static_cast<int>(static_cast<std::int64_t>(n) * (w + 1) / workers);
+    }
+    std::atomic<int> pending{n};
+    std::atomic<int> done{0};
+    std::exception_ptr error;
+    std::mutex error_m;
+    // idle workers park on idle_cv; `published` moves whenever a thief
+    // installs a stolen range, the last task is taken or a worker leaves
+    std::mutex idle_m;
+    std::condition_variable idle_cv;
+    std::uint64_t published{0};
+    auto wake{[&] {
+        {
+            std::lock_guard<std::mutex> lock(idle_m);
+            ++published;
+        }
+        idle_cv.notify_all();
+    }};
+
+    auto work{[&] (int w) {
+        detail::ThreadCap serial(1);
+        Arena arena(opt.arena_bytes);
+        auto& own{ranges[w]};
+        int i{0};
+        while (!batch.stop_requested() && pending.load(std::memory_order_acquire) > 0) {
+            if (!own.pop(i)) {
+                // own range is empty, scan the others once starting next door
+                std::uint64_t seen;
+                {
+                    std::lock_guard<std::mutex> lock(idle_m);
+                    seen = published;
+                }
+                int b{0}, e{0};
+                bool stolen{false};
+                for (int k = 1; k < workers && !stolen; ++k) {
+                    stolen = ranges[(w + k) % workers].steal(b, e);
+                }
+                if (!stolen) {
+                    // the remaining tasks are in flight between a victim and
+                    // a thief; sleep until the thief publishes its range or
+                    // the batch winds down instead of spinning
+                    std::unique_lock<std::mutex> lock(idle_m);
+                    idle_cv.wait(lock, [&] {
+                        return published != seen || pending.load(std::memory_order_acquire) == 0 || batch.stop_requested();
+                    });
+                    continue;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(own.m);
+                    own.begin = b;
+                    own.end = e;
+                }
+                wake();
+                continue;
+            }
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) wake();
+
+            arena.reset();
+            const auto deadline{opt.task_budget > clock::duration::zero()
+                ? clock::now() + opt.task_budget : clock::time_point::max()};
+            StopToken token(deadline, &batch);
+            try {
+                fn(i, SolveContext(i, w, arena, token, batch));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_m);
+                if (!error) error = std::current_exception();
+                batch.request_stop();
+            }
+            done.fetch_add(1, std::memory_order_relaxed);
+        }
+        // parked workers recheck the stop conditions
+        wake();
+    }};
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (int w = 1; w < workers; ++w) threads.emplace_back(work, w);
+    work(0);
+    for (auto& t : threads) t.join();
+
+    if (error) std::rethrow_exception(error);
+    return SolveResult{done.load(), n - done.load()};
 }
 
+namespace ad {
+
 template<typename T>
-Array<T>::Array(int size)
+struct Tape;
+
+template<typename T>
+struct Var
 {
-    assert(size > 0);
-    data_.resize(size);
-}
+    Var() : tape_(nullptr), id_(-1) {}
+
+    inline Tape<T>* tape() const { return tape_; }
+    inline int id() const { return id_; }
+    inline int row() const { return tape_->nodes_[id_].row; }
+    inline int col() const { return tape_->nodes_[id_].col; }
+    inline int size() const { return row() * col(); }
+    inline bool is_scalar() const { return size() == 1; }
+    inline T scalar() const { QS_ASSERT(is_scalar()); return tape_->nodes_[id_].val[0]; }
+    MatrixX<T> value() const;
+
+    Var t() const;
+    Var norm2() const;
+    Var norm1() const;
+    Var sum() const;
+    Var abs() const;
+    Var exp() const;
+    Var log() const;
+    Var square() const;
+    Var emul(const Var& other) const;
+    Var operator-() const;
+private:
+    friend struct Tape<T>;
+
+    Var(Tape<T>* tape, int id) : tape_(tape), id_(id) {}
+
+    Tape<T>* tape_;
+    int id_;
+}; // struct Var
 
 template<typename T>
-Array<T>::Array(const Array& other)
-    : data_(other.data_)
+struct Tape
 {
-}
+    explicit Tape(bool second_order = false);
+    Tape(const Tape&) = delete;
+    Tape& operator=(const Tape&) = delete;
+
+    Var<T> var(const MatrixX<T>& x);
+    Var<T> var(const MatrixX<T>& x, const MatrixX<T>& dx);
+    Var<T> constant(const MatrixX<T>& x);
+    void backward(const Var<T>& y);
+    MatrixX<T> grad(const Var<T>& x) const;
+    MatrixX<T> hvp(const Var<T>& x) const;
+    void reset();
+
+    template<typename F>
+    T gradient(F&& f, const MatrixX<T>& x, MatrixX<T>& g);
+    template<typename F>
+    MatrixX<T> hvp(F&& f, const MatrixX<T>& x, const MatrixX<T>& v);
+
+    inline int size() const { return nodes_.size(); }
+    inline bool second_order() const { return second_order_; }
+    inline const Arena& arena() const { return arena_; }
+private:
+    enum class Op
+    {
+        leaf,
+        add,
+        sub,
+        neg,
+        scale,
+        matmul,
+        transpose,
+        emul,
+        norm2,
+        norm1,
+        sum,
+        abs,
+        exp,
+        log,
+        square,
+    }; // enum class Op
+
+    struct Node
+    {
+        Op op;
+        int a;
+        int b;
+        int row;
+        int col;
+        T k;
+        T* val;
+        T* tan;
+        T* adj;
+        T* adj_tan;
+    }; // struct Node
+
+    friend struct Var<T>;
+    template<typename U>
+    friend Var<U> operator+(const Var<U>& a, const Var<U>& b);
+    template<typename U>
+    friend Var<U> operator-(const Var<U>& a, const Var<U>& b);
+    template<typename U>
+    friend Var<U> operator*(const Var<U>& a, const Var<U>& b);
+    template<typename U>
+    friend Var<U> operator*(U k, const Var<U>& a);
+
+    Var<T> push(Op op, int a, int b, int row, int col, T k = 0);
+    Var<T> leaf(const MatrixX<T>& x, const MatrixX<T>* dx);
+    void forward(Node& n);
+    void reverse(const Node& n);
+    void gemm_acc(T* c, const T* a, bool ta, const T* b, bool tb, int m, int k, int n);
+
+    std::vector<Node> nodes_;
+    Arena arena_;
+    // transposed gemm operands, reused across products
+    std::vector<T> scratch_;
+    bool second_order_;
+}; // struct Tape
 
 template<typename T>
-Array<T>::Array(Array&& other)
-    : data_(std::move(other.data_))
+Tape<T>::Tape(bool second_order)
+    : second_order_(second_order)
+{}
+
+template<typename T>
+void Tape<T>::reset()
 {
+    nodes_.clear();
+    arena_.reset();
 }
 
 template<typename T>
-Array<T>& Array<T>::operator=(const Array& other)
+Var<T> Tape<T>::leaf(const MatrixX<T>& x, const MatrixX<T>* dx)
 {
-    if (this != &other) {
-        data_ = other.data_;
+    Node n{Op::leaf, -1, -1, x.row(), x.col(), 0, nullptr, nullptr, nullptr, nullptr};
+    const auto size{x.size()};
+    n.val = arena_.alloc<T>(size);
+    std::copy(x.data(), x.data() + size, n.val);
+    if (second_order_) {
+        if (dx) {
+            QS_ASSERT(dx->size() == size);
+            n.tan = arena_.alloc<T>(size);
+            std::copy(dx->data(), dx->data() + size, n.tan);
+        } else {
+            n.tan = arena_.alloc_0<T>(size);
+        }
     }
-    return *this;
+    nodes_.push_back(n);
+    return Var<T>(this, nodes_.size() - 1);
 }
 
 template<typename T>
-Array<T>& Array<T>::operator=(Array&& other)
+Var<T> Tape<T>::var(const MatrixX<T>& x)
 {
-    data_ = std::move(other.data_);
-    return *this;
+    return leaf(x, nullptr);
 }
 
 template<typename T>
-bool Array<T>::operator==(const Array<T>& other) const
+Var<T> Tape<T>::var(const MatrixX<T>& x, const MatrixX<T>& dx)
 {
-    const auto matrix_size{size()};
-    if (matrix_size == other.size()) return false;
-    for (int i = 0; i < matrix_size; ++i) {
-        if (at(i) != other.at(i)) return false;
-    }
-    return true;
+    QS_ASSERT(second_order_);
+    return leaf(x, &dx);
 }
 
 template<typename T>
-Array<T> Array<T>::operator*(const Array<T>& other) const
+Var<T> Tape<T>::constant(const MatrixX<T>& x)
 {
-    assert(other.size() == size());
-    Array<T> out{*this};
-    const auto matrix_size{size()};
-    for (int i = 0; i < matrix_size; ++i) {
-        out.at(i) *= other.at(i);
-    }
-    return out;
+    return leaf(x, nullptr);
 }
 
 template<typename T>
-Array<T> Array<T>::operator*(T v) const
+Var<T> Tape<T>::push(Op op, int a, int b, int row, int col, T k)
 {
-    Array<T> out{*this};
-    auto matrix_size{size()};
-    for (int i = 0; i < matrix_size; ++i) {
-        out.at(i) *= v;
-    }
-    return out;
+    Node n{op, a, b, row, col, k, nullptr, nullptr, nullptr, nullptr};
+    n.val = arena_.alloc<T>(row * col);
+    if (second_order_) n.tan = arena_.alloc<T>(row * col);
+    forward(n);
+    nodes_.push_back(n);
+    return Var<T>(this, nodes_.size() - 1);
 }
 
 template<typename T>
-Array<T> Array<T>::operator+(const Array<T>& other) const
+void Tape<T>::gemm_acc(T* c, const T* a, bool ta, const T* b, bool tb, int m, int k, int n)
 {
-    assert(other.size() == size());
-    Array<T> out{*this};
-    const auto matrix_size{size()};
-    for (int i = 0; i < matrix_size; ++i) {
-        out.at(i) += other.at(i);
+    // c(m x n) += op(a)(m x k) * op(b)(k x n), row major, on the blocked
+    // gemm; transposed operands are transposed into scratch first
+    const auto sa{ta ? static_cast<std::size_t>(m) * k : 0};
+    const auto sb{tb ? static_cast<std::size_t>(k) * n : 0};
+    if (scratch_.size() < sa + sb) scratch_.resize(sa + sb);
+    if (ta) {
+        detail::transpose(a, m, scratch_.data(), k, k, m);
+        a = scratch_.data();
     }
-    return out;
+    if (tb) {
+        detail::transpose(b, k, scratch_.data() + sa, n, n, k);
+        b = scratch_.data() + sa;
+    }
+    detail::gemm(a, b, c, m, k, n);
 }
 
 template<typename T>
-Array<T> Array<T>::operator-(const Array<T>& other) const
+void Tape<T>::forward(Node& n)
 {
-    assert(other.size() == size());
-    Array<T> out{*this};
-    const auto matrix_size{size()};
-    for (int i = 0; i < matrix_size; ++i) {
-        out.at(i) -= other.at(i);
+    const auto size{n.row * n.col};
+    const Node& a{nodes_[n.a]};
+    const T* va{a.val};
+    const T* ta{a.tan};
+    T* v{n.val};
+    T* t{n.tan};
+
+    switch (n.op) {
+    case Op::leaf:
+        break;
+    case Op::add: {
+        const Node& b{nodes_[n.b]};
+        for (int i = 0; i < size; ++i) v[i] = va[i] + b.val[i];
+        if (t) for (int i = 0; i < size; ++i) t[i] = ta[i] + b.tan[i];
+        break;
+    }
+    case Op::sub: {
+        const Node& b{nodes_[n.b]};
+        for (int i = 0; i < size; ++i) v[i] = va[i] - b.val[i];
+        if (t) for (int i = 0; i < size; ++i) t[i] = ta[i] - b.tan[i];
+        break;
+    }
+    case Op::neg:
+        for (int i = 0; i < size; ++i) v[i] = -va[i];
+        if (t) for (int i = 0; i < size; ++i) t[i] = -ta[i];
+        break;
+    case Op::scale:
+        for (int i = 0; i < size; ++i) v[i] = n.k * va[i];
+        if (t) for (int i = 0; i < size; ++i) t[i] = n.k * ta[i];
+        break;
+    case Op::matmul: {
+        const Node& b{nodes_[n.b]};
+        std::fill(v, v + size, T{0});
+        gemm_acc(v, va, false, b.val, false, n.row, a.col, n.col);
+        if (t) {
+            std::fill(t, t + size, T{0});
+            gemm_acc(t, ta, false, b.val, false, n.row, a.col, n.col);
+            gemm_acc(t, va, false, b.tan, false, n.row, a.col, n.col);
+        }
+        break;
+    }
+    case Op::transpose:
+        for (int r = 0; r < a.row; ++r) {
+            for (int c = 0; c < a.col; ++c) v[c * a.row + r] = va[r * a.col + c];
+        }
+        if (t) {
+            for (int r = 0; r < a.row; ++r) {
+                for (int c = 0; c < a.col; ++c) t[c * a.row + r] = ta[r * a.col + c];
+            }
+        }
+        break;
+    case Op::emul: {
+        const Node& b{nodes_[n.b]};
+        for (int i = 0; i < size; ++i) v[i] = va[i] * b.val[i];
+        if (t) for (int i = 0; i < size; ++i) t[i] = ta[i] * b.val[i] + va[i] * b.tan[i];
+        break;
+    }
+    case Op::norm2: {
+        const auto a_size{a.row * a.col};
+        T s{0};
+        for (int i = 0; i < a_size; ++i) s += va[i] * va[i];
+        v[0] = std::sqrt(s);
+        if (t) {
+            T d{0};
+            for (int i = 0; i < a_size; ++i) d += va[i] * ta[i];
+            t[0] = v[0] == 0 ? T{0} : d / v[0];
+        }
+        break;
+    }
+    case Op::norm1: {
+        const auto a_size{a.row * a.col};
+        T s{0};
+        for (int i = 0; i < a_size; ++i) s += std::abs(va[i]);
+        v[0] = s;
+        if (t) {
+            T d{0};
+            for (int i = 0; i < a_size; ++i) d += va[i] > 0 ? ta[i] : (va[i] < 0 ? -ta[i] : T{0});
+            t[0] = d;
+        }
+        break;
+    }
+    case Op::sum: {
+        const auto a_size{a.row * a.col};
+        T s{0};
+        for (int i = 0; i < a_size; ++i) s += va[i];
+        v[0] = s;
+        if (t) {
+            T d{0};
+            for (int i = 0; i < a_size; ++i) d += ta[i];
+            t[0] = d;
+        }
+        break;
+    }
+    case Op::abs:
+        for (int i = 0; i < size; ++i) v[i] = std::abs(va[i]);
+        if (t) for (int i = 0; i < size; ++i) t[i] = va[i] > 0 ? ta[i] : (va[i] < 0 ? -ta[i] : T{0});
+        break;
+    case Op::exp:
+        for (int i = 0; i < size; ++i) v[i] = std::exp(va[i]);
+        if (t) for (int i = 0; i < size; ++i) t[i] = v[i] * ta[i];
+        break;
+    case Op::log:
+        for (int i = 0; i < size; ++i) v[i] = std::log(va[i]);
+        if (t) for (int i = 0; i < size; ++i) t[i] = ta[i] / va[i];
+        break;
+    case Op::square:
+        for (int i = 0; i < size; ++i) v[i] = va[i] * va[i];
+        if (t) for (int i = 0; i < size; ++i) t[i] = 2 * va[i] * ta[i];
+        break;
     }
-    return out;
 }
 
 template<typename T>
-Array<T> Array<T>::operator+(T v) const
+void Tape<T>::reverse(const Node& n)
 {
-    Array<T> out{*this};
-    const auto matrix_size{size()};
-    for (int i = 0; i < matrix_size; ++i) {
-        out.at(i) += v;
+    if (n.op == Op::leaf) return;
+
+    const auto size{n.row * n.col};
+    Node& a{nodes_[n.a]};
+    const T* g{n.adj};
+    const T* dg{n.adj_tan};
+    T* ga{a.adj};
+    T* dga{a.adj_tan};
+
+    switch (n.op) {
+    case Op::leaf:
+        break;
+    case Op::add:
+    case Op::sub: {
+        Node& b{nodes_[n.b]};
+        const T sign{n.op == Op::add ? T{1} : T{-1}};
+        for (int i = 0; i < size; ++i) ga[i] += g[i];
+        for (int i = 0; i < size; ++i) b.adj[i] += sign * g[i];
+        if (dg) {
+            for (int i = 0; i < size; ++i) dga[i] += dg[i];
+            for (int i = 0; i < size; ++i) b.adj_tan[i] += sign * dg[i];
+        }
+        break;
+    }
+    case Op::neg:
+        for (int i = 0; i < size; ++i) ga[i] -= g[i];
+        if (dg) for (int i = 0; i < size; ++i) dga[i] -= dg[i];
+        break;
+    case Op::scale:
+        for (int i = 0; i < size; ++i) ga[i] += n.k * g[i];
+        if (dg) for (int i = 0; i < size; ++i) dga[i] += n.k * dg[i];
+        break;
+    case Op::matmul: {
+        // C = AB: dA += dC B^T, dB += A^T dC
+        Node& b{nodes_[n.b]};
+        const int m{n.row};
+        const int k{a.col};
+        const int c{n.col};
+        gemm_acc(ga, g, false, b.val, true, m, c, k);
+        gemm_acc(b.adj, a.val, true, g, false, k, m, c);
+        if (dg) {
+            gemm_acc(dga, dg, false, b.val, true, m, c, k);
+            gemm_acc(dga, g, false, b.tan, true, m, c, k);
+            gemm_acc(b.adj_tan, a.tan, true, g, false, k, m, c);
+            gemm_acc(b.adj_tan, a.val, true, dg, false, k, m, c);
+        }
+        break;
+    }
+    case Op::transpose:
+        for (int r = 0; r < a.row; ++r) {
+            for (int c = 0; c < a.col; ++c) ga[r * a.col + c] += g[c * a.row + r];
+        }
+        if (dg) {
+            for (int r = 0; r < a.row; ++r) {
+                for (int c = 0; c < a.col; ++c) dga[r * a.col + c] += dg[c * a.row + r];
+            }
+        }
+        break;
+    case Op::emul: {
+        Node& b{nodes_[n.b]};
+        for (int i = 0; i < size; ++i) {
+            ga[i] += g[i] * b.val[i];
+            b.adj[i] += g[i] * a.val[i];
+        }
+        if (dg) {
+            for (int i = 0; i < size; ++i) {
+                dga[i] += dg[i] * b.val[i] + g[i] * b.tan[i];
+                b.adj_tan[i] += dg[i] * a.val[i] + g[i] * a.tan[i];
+            }
+        }
+        break;
+    }
+    case Op::norm2: {
+        const auto a_size{a.row * a.col};
+        const T s{n.val[0]};
+        if (s == 0) break;
+        for (int i = 0; i < a_size; ++i) ga[i] += g[0] * a.val[i] / s;
+        if (dg) {
+            const T ds{n.tan[0]};
+            for (int i = 0; i < a_size; ++i) {
+                dga[i] += dg[0] * a.val[i] / s + g[0] * (a.tan[i] - a.val[i] * ds / s) / s;
+            }
+        }
+        break;
+    }
+    case Op::norm1:
+    case Op::sum: {
+        const auto a_size{a.row * a.col};
+        for (int i = 0; i < a_size; ++i) {
+            const T d{n.op == Op::sum ? T{1} : (a.val[i] > 0 ? T{1} : (a.val[i] < 0 ? T{-1} : T{0}))};
+            ga[i] += g[0] * d;
+            if (dg) dga[i] += dg[0] * d;
+        }
+        break;
+    }
+    case Op::abs:
+        for (int i = 0; i < size; ++i) {
+            const T d{a.val[i] > 0 ? T{1} : (a.val[i] < 0 ? T{-1} : T{0})};
+            ga[i] += g[i] * d;
+            if (dg) dga[i] += dg[i] * d;
+        }
+        break;
+    case Op::exp:
+        for (int i = 0; i < size; ++i) ga[i] += g[i] * n.val[i];
+        if (dg) for (int i = 0; i < size; ++i) dga[i] += dg[i] * n.val[i] + g[i] * n.tan[i];
+        break;
+    case Op::log:
+        for (int i = 0; i < size; ++i) ga[i] += g[i] / a.val[i];
+        if (dg) {
+            for (int i = 0; i < size; ++i) {
+                dga[i] += dg[i] / a.val[i] - g[i] * a.tan[i] / (a.val[i] * a.val[i]);
+            }
+        }
+        break;
+    case Op::square:
+        for (int i = 0; i < size; ++i) ga[i] += 2 * g[i] * a.val[i];
+        if (dg) for (int i = 0; i < size; ++i) dga[i] += 2 * (dg[i] * a.val[i] + g[i] * a.tan[i]);
+        break;
     }
-    return out;
 }
 
 template<typename T>
-Array<T> Array<T>::operator-(T v) const
+void Tape<T>::backward(const Var<T>& y)
 {
-    Array<T> out{*this};
-    const auto matrix_size{size()};
-    for (int i = 0; i < matrix_size; ++i) {
-        out.at(i) -= v;
+    QS_ASSERT(y.tape() == this && y.is_scalar());
+
+    // adjoints only live in the arena for the nodes up to y
+    for (int i = 0; i <= y.id(); ++i) {
+        auto& n{nodes_[i]};
+        const auto size{n.row * n.col};
+        n.adj = arena_.alloc_0<T>(size);
+        if (second_order_) n.adj_tan = arena_.alloc_0<T>(size);
+    }
+
+    nodes_[y.id()].adj[0] = 1;
+    for (int i = y.id(); i >= 0; --i) {
+        reverse(nodes_[i]);
     }
-    return out;
 }
 
 template<typename T>
-Array<T> Array<T>::sign()
+MatrixX<T> Tape<T>::grad(const Var<T>& x) const
 {
-    Array<T> out(size());
-    const auto array_size{size()};
-    for (int i = 0; i < array_size; ++i) {
-        out.at(i) = at(i) > 0 ? 1 : -1;
-    }
+    const auto& n{nodes_[x.id()]};
+    QS_ASSERT(n.adj);
+    MatrixX<T> out(n.row, n.col);
+    for (int i = 0; i < out.size(); ++i) out.at(i) = n.adj[i];
     return out;
 }
 
 template<typename T>
-void Array<T>::max_(T v)
+MatrixX<T> Tape<T>::hvp(const Var<T>& x) const
 {
-    const auto array_size{size()};
-    for (int i = 0; i < array_size; ++i) {
-        at(i) = std::max(at(i), v);
-    }
+    const auto& n{nodes_[x.id()]};
+    QS_ASSERT(n.adj_tan);
+    MatrixX<T> out(n.row, n.col);
+    for (int i = 0; i < out.size(); ++i) out.at(i) = n.adj_tan[i];
+    return out;
 }
 
 template<typename T>
-void Array<T>::abs_()
+template<typename F>
+T Tape<T>::gradient(F&& f, const MatrixX<T>& x, MatrixX<T>& g)
 {
-    const auto array_size{size()};
-    for (int i = 0; i < array_size; ++i) {
-        at(i) = std::abs(at(i));
-    }
+    reset();
+    auto xv{var(x)};
+    auto y{f(xv)};
+    backward(y);
+    g = grad(xv);
+    return y.scalar();
 }
 
 template<typename T>
-Array<T> Array<T>::max(T v) const
+template<typename F>
+MatrixX<T> Tape<T>::hvp(F&& f, const MatrixX<T>& x, const MatrixX<T>& v)
 {
-    Array<T>out(*this);
-    out.max_(v);
-    return out;
+    // forward-over-reverse: seed the tangent of x with v, the adjoint
+    // tangents after the reverse sweep are H * v
+    QS_ASSERT(second_order_);
+    reset();
+    auto xv{var(x, v)};
+    auto y{f(xv)};
+    backward(y);
+    return hvp(xv);
 }
 
 template<typename T>
-Array<T> Array<T>::abs() const
+MatrixX<T> Var<T>::value() const
 {
-    Array<T>out(*this);
-    out.abs_();
+    const auto& n{tape_->nodes_[id_]};
+    MatrixX<T> out(n.row, n.col);
+    for (int i = 0; i < out.size(); ++i) out.at(i) = n.val[i];
     return out;
 }
 
 template<typename T>
-typename MatrixX<T>::MatrixInitalizer MatrixX<T>::operator<<(T v)
+Var<T> Var<T>::t() const
 {
-    MatrixInitalizer mi(this);
-    array_.at(0) = v;
-    return mi;
+    return tape_->push(Tape<T>::Op::transpose, id_, -1, col(), row());
 }
 
 template<typename T>
-typename MatrixX<T>::MatrixInitalizer& MatrixX<T>::MatrixInitalizer::operator,(T v)
+Var<T> Var<T>::norm2() const
 {
-    m->array_.at(i++) = v;
-    return *this;
+    QS_ASSERT(col() == 1);
+    return tape_->push(Tape<T>::Op::norm2, id_, -1, 1, 1);
 }
 
 template<typename T>
-MatrixX<T>::MatrixX(int row, int col)
-    : array_(row * col)
-    , row_(row)
-    , col_(col)
-{}
+Var<T> Var<T>::norm1() const
+{
+    QS_ASSERT(col() == 1);
+    return tape_->push(Tape<T>::Op::norm1, id_, -1, 1, 1);
+}
 
 template<typename T>
-MatrixX<T>::MatrixX(const MatrixX& other)
-    : MatrixX(other.row_, other.col_, other.array_)
+Var<T> Var<T>::sum() const
 {
+    return tape_->push(Tape<T>::Op::sum, id_, -1, 1, 1);
 }
 
 template<typename T>
-MatrixX<T>::MatrixX(int row, int col, const Array<T>& other)
-    : array_(other)
-    , row_(row)
-    , col_(col)
-{}
+Var<T> Var<T>::abs() const
+{
+    return tape_->push(Tape<T>::Op::abs, id_, -1, row(), col());
+}
 
 template<typename T>
-MatrixX<T>::MatrixX(int row, int col, Array<T>&& other)
-    : array_(std::move(other))
-    , row_(row)
-    , col_(col)
-{}
+Var<T> Var<T>::exp() const
+{
+    return tape_->push(Tape<T>::Op::exp, id_, -1, row(), col());
+}
 
 template<typename T>
-MatrixX<T>::MatrixX(MatrixX&& other)
-    : MatrixX(other.row_, other.col_, std::move(other.array_))
+Var<T> Var<T>::log() const
 {
+    return tape_->push(Tape<T>::Op::log, id_, -1, row(), col());
 }
 
 template<typename T>
-MatrixX<T>& MatrixX<T>::operator=(const MatrixX& other)
+Var<T> Var<T>::square() const
 {
-    if (this != &other) {
-        array_ = other.array_;
-    }
-    return *this;
+    return tape_->push(Tape<T>::Op::square, id_, -1, row(), col());
 }
 
 template<typename T>
-MatrixX<T>& MatrixX<T>::operator=(MatrixX&& other)
+Var<T> Var<T>::emul(const Var& other) const
 {
-    array_ = std::move(other.array_);
-    return *this;
+    QS_ASSERT(tape_ == other.tape_ && row() == other.row() && col() == other.col());
+    return tape_->push(Tape<T>::Op::emul, id_, other.id_, row(), col());
 }
 
 template<typename T>
-MatrixX<T>& MatrixX<T>::operator=(const Array<T>& other)
+Var<T> Var<T>::operator-() const
 {
-    array_ = other;
-    return *this;
+    return tape_->push(Tape<T>::Op::neg, id_, -1, row(), col());
 }
 
 template<typename T>
-MatrixX<T>& MatrixX<T>::operator=(Array<T>&& other)
+Var<T> operator+(const Var<T>& a, const Var<T>& b)
 {
-    array_ = std::move(other);
-    return *this;
+    QS_ASSERT(a.tape() == b.tape() && a.row() == b.row() && a.col() == b.col());
+    return a.tape()->push(Tape<T>::Op::add, a.id(), b.id(), a.row(), a.col());
 }
 
 template<typename T>
-MatrixX<T> MatrixX<T>::eye(int row_col)
+Var<T> operator-(const Var<T>& a, const Var<T>& b)
 {
-    MatrixX<T> m(row_col, row_col);
-    m.eye_();
-    return m;
+    QS_ASSERT(a.tape() == b.tape() && a.row() == b.row() && a.col() == b.col());
+    return a.tape()->push(Tape<T>::Op::sub, a.id(), b.id(), a.row(), a.col());
 }
 
 template<typename T>
-void MatrixX<T>::eye_()
+Var<T> operator*(const Var<T>& a, const Var<T>& b)
 {
-    assert(row() == col());
-    for (int i = 0; i < row(); ++i) {
-        at(i, i) = 1;
-    }
+    QS_ASSERT(a.tape() == b.tape() && a.col() == b.row());
+    return a.tape()->push(Tape<T>::Op::matmul, a.id(), b.id(), a.row(), b.col());
 }
 
 template<typename T>
-MatrixX<T> MatrixX<T>::t() const
+Var<T> operator*(T k, const Var<T>& a)
 {
-    MatrixX<T> m(col(), row());
-    for (int r = 0; r < row(); ++r) {
-        for (int c = 0; c < col(); ++c) {
-            m.at(c, r) = at(r, c);
-        }
-    }
-    return m;
+    return a.tape()->push(Tape<T>::Op::scale, a.id(), -1, a.row(), a.col(), k);
 }
 
 template<typename T>
-MatrixX<T> MatrixX<T>::inv() const
-{
-    // Gauss Jordan algorithm
-    auto out{MatrixX<T>::eye(row())};
-    auto tmp_m{*this};
+Var<T> operator*(const Var<T>& a, T k) { return k * a; }
+template<typename T>
+Var<T> operator+(const Var<T>& a, const MatrixX<T>& b) { return a + a.tape()->constant(b); }
+template<typename T>
+Var<T> operator+(const MatrixX<T>& a, const Var<T>& b) { return b.tape()->constant(a) + b; }
+template<typename T>
+Var<T> operator-(const Var<T>& a, const MatrixX<T>& b) { return a - a.tape()->constant(b); }
+template<typename T>
+Var<T> operator-(const MatrixX<T>& a, const Var<T>& b) { return b.tape()->constant(a) - b; }
+template<typename T>
+Var<T> operator*(const Var<T>& a, const MatrixX<T>& b) { return a * a.tape()->constant(b); }
+template<typename T>
+Var<T> operator*(const MatrixX<T>& a, const Var<T>& b) { return b.tape()->constant(a) * b; }
 
-    auto row_swap{[] (MatrixX<T>& m, int r1, int r2) -> void {
-        for (int c = 0; c < m.col(); ++c) {
-            T tmp{m.at(r1, c)};
-            m.at(r1, c) = m.at(r2, c);
-            m.at(r2, c) = tmp;
-        }
-    }};
+template<typename T, typename F>
+T gradient(F&& f, const MatrixX<T>& x, MatrixX<T>& g)
+{
+    Tape<T> tape;
+    return tape.gradient(std::forward<F>(f), x, g);
+}
 
-    for (int c = 0; c < out.col(); ++c) {
-        if (tmp_m.at(c, c) == 0) {
-            // swap row
-            for (int r1 = c + 1; r1 < out.row(); ++r1) {
-                if (tmp_m.at(r1, c) != 0) {
-                    row_swap(tmp_m, c, r1);
-                    row_swap(out, c, r1);
-                }
-            }
-        }
+template<typename T, typename F>
+MatrixX<T> hvp(F&& f, const MatrixX<T>& x, const MatrixX<T>& v)
+{
+    Tape<T> tape(true);
+    return tape.hvp(std::forward<F>(f), x, v);
+}
 
-        auto tmp{tmp_m.at(c, c)};
-        for (int c1 = 0; c1 < out.col(); ++c1) {
-            tmp_m.at(c, c1) /= tmp;
-            out.at(c, c1) /= tmp;
-        }
+} // namespace ad
 
-        for (int r = 0; r < out.row(); ++r) {
-            if (r == c) continue;
-            const auto t{tmp_m.at(r, c)};
-            for (int c1 = 0; c1 < out.col(); ++c1) {
-                out.at(r, c1) -= out.at(c, c1) * t;
-                tmp_m.at(r, c1) -= t * tmp_m.at(c, c1);
-            }
-        }
-    }
+namespace optim {
 
-    return out;
-}
+enum class Status
+{
+    converged_grad,
+    converged_f,
+    max_iter,
+    line_search_failed,
+    stopped,
+}; // enum class Status
 
 template<typename T>
-T MatrixX<T>::det() const
+struct Options
 {
-    assert(row() == col());
+    int max_iter{1000};
+    // stop when ‖g‖∞ <= grad_tol
+    T grad_tol{static_cast<T>(1.0e-6)};
+    // stop when |f_k-1 - f_k| <= f_tol * max(1, |f_k|)
+    T f_tol{0};
+    // L-BFGS history size
+    int history{8};
+    // strong Wolfe constants, 0 < c1 < c2 < 1, ConjugateGradient wants a
+    // tighter c2 (~0.1) than the quasi-Newton default
+    T c1{static_cast<T>(1.0e-4)};
+    T c2{static_cast<T>(0.9)};
+    int max_line_search{20};
+    T step_max{static_cast<T>(1.0e10)};
+    // checked once per iteration, may be null
+    const StopToken* stop{nullptr};
+}; // struct Options
 
-    if (row() == 1) {
-        return array_.at(0);
-    } else if (row() == 2) {
-        return at(0, 0) * at(1, 1) - at(1, 0) * at(0, 1);
-    }
+template<typename T>
+struct Result
+{
+    Status status;
+    int iter;
+    int evals;
+    T fx;
+    T grad_norm;
+}; // struct Result
 
-    // calculate determinant with cofactor expansions
+template<typename T>
+T dot(const MatrixX<T>& a, const MatrixX<T>& b)
+{
+    QS_ASSERT(a.size() == b.size());
+    const T* pa{a.data()};
+    const T* pb{b.data()};
+    const auto size{a.size()};
     T result{0};
-    MatrixX<T> minor(row() - 1, col() - 1);
-    for (int c = 0; c < col(); ++c) {
-        T sign{(1 + 1 + c) % 2 == 0 ? static_cast<T>(1) : static_cast<T>(-1)};
-        T pivot{at(0, c)};
-
-        // expansion for first row
-        for (int mr = 1; mr < row(); ++mr) {
-            int cc{0};
-            for (int mc = 0; mc < col(); ++mc) {
-                if (c == mc) continue;
-                minor.at(mr - 1, cc++) = at(mr, mc);
-            }
-        }
-
-        result += sign * pivot * minor.det();
-    }
+    for (int i = 0; i < size; ++i) result += pa[i] * pb[i];
     return result;
 }
 
 template<typename T>
-T MatrixX<T>::trace() const
+T norm_inf(const MatrixX<T>& a)
 {
-    assert(row() == col());
+    const auto size{a.size()};
     T result{0};
-    for (int r = 0; r < row(); ++r) {
-        result += at(r, r);
-    }
+    for (int i = 0; i < size; ++i) result = std::max(result, std::abs(a.at(i)));
     return result;
 }
 
+// y += alpha * x
 template<typename T>
-T MatrixX<T>::norm2() const
+void axpy_(MatrixX<T>& y, T alpha, const MatrixX<T>& x)
 {
-    assert(col() == 1);
-
-    const auto matrix_size{size()};
-    T result{0};
-    for (int i = 0; i < matrix_size; ++i) {
-        result += at(i) * at(i);
-    }
-    return std::sqrt(result);
+    QS_ASSERT(y.size() == x.size());
+    T* py{y.data()};
+    const T* px{x.data()};
+    const auto size{y.size()};
+    for (int i = 0; i < size; ++i) py[i] += alpha * px[i];
 }
 
+// Line search satisfying the strong Wolfe conditions (Nocedal & Wright,
+// algorithm 3.5/3.6 with cubic interpolation). The objective is only ever
+// evaluated at the trial points, the accepted point is left in x, fx and g.
 template<typename T>
-T MatrixX<T>::norm1() const
+struct LineSearch
 {
-    assert(col() == 1);
+    LineSearch(int n) : x0_(n, 1), g0_(n, 1) {}
 
-    const auto matrix_size{size()};
-    T result{0};
-    for (int i = 0; i < matrix_size; ++i) {
-        result += std::abs(at(i));
+    template<typename F>
+    bool search(F& f, MatrixX<T>& x, T& fx, MatrixX<T>& g, const MatrixX<T>& d,
+                T& step, const Options<T>& opt, int& evals);
+private:
+    template<typename F>
+    T eval(F& f, MatrixX<T>& x, MatrixX<T>& g, const MatrixX<T>& d, T step, int& evals);
+    static T cubic_min(T a, T fa, T da, T b, T fb, T db);
+
+    MatrixX<T> x0_;
+    MatrixX<T> g0_;
+}; // struct LineSearch
+
+template<typename T>
+template<typename F>
+T LineSearch<T>::eval(F& f, MatrixX<T>& x, MatrixX<T>& g, const MatrixX<T>& d, T step, int& evals)
+{
+    const auto size{x.size()};
+    for (int i = 0; i < size; ++i) x.at(i) = x0_.at(i) + step * d.at(i);
+    ++evals;
+    return f(static_cast<const MatrixX<T>&>(x), g);
+}
+
+template<typename T>
+T LineSearch<T>::cubic_min(T a, T fa, T da, T b, T fb, T db)
+{
+    // minimizer of the cubic interpolating f and f' at a and b, safeguarded
+    // to stay inside the bracket, falls back to bisection
+    const auto lo{std::min(a, b)};
+    const auto hi{std::max(a, b)};
+    const auto d1{da + db - 3 * (fa - fb) / (a - b)};
+    const auto disc{d1 * d1 - da * db};
+    if (disc >= 0) {
+        const auto d2{(b > a ? 1 : -1) * std::sqrt(disc)};
+        const auto denom{db - da + 2 * d2};
+        if (denom != 0) {
+            const auto m{b - (b - a) * (db + d2 - d1) / denom};
+            const auto margin{static_cast<T>(0.1) * (hi - lo)};
+            if (m >= lo + margin && m <= hi - margin) return m;
+        }
     }
-    return result;
+    return (lo + hi) / 2;
 }
 
 template<typename T>
-MatrixX<T> MatrixX<T>::sub(int sr, int sc, int r, int c) const
+template<typename F>
+bool LineSearch<T>::search(F& f, MatrixX<T>& x, T& fx, MatrixX<T>& g, const MatrixX<T>& d,
+                           T& step, const Options<T>& opt, int& evals)
 {
-    // check
-    assert(sr >= 0 && sc >= 0);
-    assert(sr + r <= row() && sc + c <= col());
+    x0_ = x;
+    g0_ = g;
+    const T f0{fx};
+    const T dphi0{dot(g, d)};
+    if (dphi0 >= 0) return false;
 
-    if (sr == 0 && sc == 0 && r == row() && c == col()) {
-        return *this;
-    } else {
-        MatrixX<T> out(r, c);
-        int out_r{0};
-        for (int i = sr; i < sr + r; ++i) {
-            int out_c{0};
-            for (int j = sc; j < sc + c; ++j) {
-                out.at(out_r, out_c++) = at(i, j);
+    T a_lo{0};
+    T f_lo{f0};
+    T d_lo{dphi0};
+    T a_hi{0};
+    T f_hi{0};
+    T d_hi{0};
+    bool bracketed{false};
+
+    T a{std::min(step, opt.step_max)};
+    for (int i = 0; i < opt.max_line_search; ++i) {
+        fx = eval(f, x, g, d, a, evals);
+        const T dphi{dot(g, d)};
+
+        if (!bracketed) {
+            if (fx > f0 + opt.c1 * a * dphi0 || (i > 0 && fx >= f_lo)) {
+                bracketed = true;
+                a_hi = a; f_hi = fx; d_hi = dphi;
+            } else if (std::abs(dphi) <= -opt.c2 * dphi0) {
+                step = a;
+                return true;
+            } else if (dphi >= 0) {
+                bracketed = true;
+                a_hi = a_lo; f_hi = f_lo; d_hi = d_lo;
+                a_lo = a; f_lo = fx; d_lo = dphi;
+            } else {
+                a_lo = a; f_lo = fx; d_lo = dphi;
+                if (a >= opt.step_max) break;
+                a = std::min(2 * a, opt.step_max);
+                continue;
+            }
+        } else {
+            // zoom
+            if (fx > f0 + opt.c1 * a * dphi0 || fx >= f_lo) {
+                a_hi = a; f_hi = fx; d_hi = dphi;
+            } else {
+                if (std::abs(dphi) <= -opt.c2 * dphi0) {
+                    step = a;
+                    return true;
+                }
+                if (dphi * (a_hi - a_lo) >= 0) {
+                    a_hi = a_lo; f_hi = f_lo; d_hi = d_lo;
+                }
+                a_lo = a; f_lo = fx; d_lo = dphi;
             }
-            ++out_r;
         }
-        return out;
+        a = cubic_min(a_lo, f_lo, d_lo, a_hi, f_hi, d_hi);
+    }
+
+    // no Wolfe point found, fall back to the best sufficient decrease point
+    if (a_lo > 0) {
+        fx = eval(f, x, g, d, a_lo, evals);
+        step = a_lo;
+        return true;
     }
+    x = x0_;
+    g = g0_;
+    fx = f0;
+    return false;
 }
 
 template<typename T>
-void MatrixX<T>::fill_rand_()
+struct Minimizer
 {
-    const auto matrix_size{size()};
-    if (std::is_integral_v<T>) {
-        for (int i = 0; i < matrix_size; ++i) at(i) = rand();
-    } else {
-        for (int i = 0; i < matrix_size; ++i) at(i) = static_cast<T>(rand()) / static_cast<T>(RAND_MAX);
+    inline const Options<T>& options() const { return opt_; }
+    inline Options<T>& options() { return opt_; }
+protected:
+    Minimizer(int n, const Options<T>& opt)
+        : opt_(opt), g_(n, 1), d_(n, 1), ls_(n)
+    {}
+
+    // returns true and fills result when a stopping criterion holds
+    bool stop(int iter, int evals, T fx, T last_fx, Result<T>& result) const;
+    // same, timed as the check phase, reports the finished iteration to obs
+    // with ‖g‖∞ as primal and |f_k-1 - f_k| as dual residual
+    template<typename O>
+    bool stop(int iter, int evals, T fx, T last_fx, Result<T>& result, O& obs) const;
+    // line search along d_, timed as the line_search phase
+    template<typename F, typename O>
+    bool search(F& f, MatrixX<T>& x, T& fx, T& step, int& evals, O& obs)
+    {
+        PhaseScope<O> scope(obs, Phase::line_search);
+        return ls_.search(f, x, fx, g_, d_, step, opt_, evals);
     }
-}
+
+    Options<T> opt_;
+    MatrixX<T> g_;
+    MatrixX<T> d_;
+    LineSearch<T> ls_;
+}; // struct Minimizer
 
 template<typename T>
-void MatrixX<T>::fill_0_()
+bool Minimizer<T>::stop(int iter, int evals, T fx, T last_fx, Result<T>& result) const
 {
-    const auto matrix_size{size()};
-    std::fill(array_.data_.begin(), array_.data_.end(), 0);
+    const auto grad_norm{norm_inf(g_)};
+    result = Result<T>{Status::max_iter, iter, evals, fx, grad_norm};
+    if (grad_norm <= opt_.grad_tol) {
+        result.status = Status::converged_grad;
+        return true;
+    }
+    if (iter > 0 && opt_.f_tol > 0 && std::abs(last_fx - fx) <= opt_.f_tol * std::max(T{1}, std::abs(fx))) {
+        result.status = Status::converged_f;
+        return true;
+    }
+    if (opt_.stop && opt_.stop->stop_requested()) {
+        result.status = Status::stopped;
+        return true;
+    }
+    return iter >= opt_.max_iter;
 }
 
 template<typename T>
-void MatrixX<T>::fill_1_()
+template<typename O>
+bool Minimizer<T>::stop(int iter, int evals, T fx, T last_fx, Result<T>& result, O& obs) const
 {
-    const auto matrix_size{size()};
-    std::fill(array_.data_.begin(), array_.data_.end(), 1);
+    bool done;
+    {
+        PhaseScope<O> scope(obs, Phase::check);
+        done = stop(iter, evals, fx, last_fx, result);
+    }
+    if constexpr (O::enabled) {
+        if (iter > 0) obs.iteration(fx, result.grad_norm, std::abs(last_fx - fx));
+    }
+    return done;
 }
 
 template<typename T>
-void MatrixX<T>::resize_(int r, int c)
+struct GradientDescent: public Minimizer<T>
 {
-    array_.col_ = c;
-    array_.row_ = r;
-    array_.data_.resize(c * r);
-}
+    GradientDescent(int n, const Options<T>& opt = Options<T>{}) : Minimizer<T>(n, opt) {}
+
+    template<typename F>
+    Result<T> minimize(F&& f, MatrixX<T>& x) { NullObserver obs; return minimize(std::forward<F>(f), x, obs); }
+    template<typename F, typename O>
+    Result<T> minimize(F&& f, MatrixX<T>& x, O& obs);
+}; // struct GradientDescent
 
 template<typename T>
-MatrixX<T> MatrixX<T>::operator*(const MatrixX& m) const
+template<typename F, typename O>
+Result<T> GradientDescent<T>::minimize(F&& f, MatrixX<T>& x, O& obs)
 {
-    MatrixX<T> out{row(), m.col()};
-    for (int r = 0; r < out.row(); ++r) {
-        for (int c = 0; c < out.col(); ++c) {
-            T v{0};
-            for (int c1 = 0; c1 < col(); ++c1) {
-                v += at(r, c1) * m.at(c1, c);
-            }
-            out.at(r, c) = v;
+    auto& g{this->g_};
+    auto& d{this->d_};
+    QS_ASSERT(x.size() == g.size());
+
+    Result<T> result;
+    int evals{1};
+    T fx{f(static_cast<const MatrixX<T>&>(x), g)};
+    T last_fx{fx};
+    T step{1 / std::max(norm_inf(g), T{1})};
+    T last_slope{0};
+    for (int iter = 0; !this->stop(iter, evals, fx, last_fx, result, obs); ++iter) {
+        {
+            PhaseScope<O> scope(obs, Phase::solve);
+            for (int i = 0; i < d.size(); ++i) d.at(i) = -g.at(i);
+        }
+        const auto slope{dot(g, d)};
+        // keep the first order change of the previous step
+        if (iter > 0) step *= last_slope / slope;
+
+        last_fx = fx;
+        if (!this->search(f, x, fx, step, evals, obs)) {
+            result.status = Status::line_search_failed;
+            break;
         }
+        last_slope = slope;
     }
-    return out;
+    return result;
 }
 
+// Nonlinear conjugate gradient, Polak-Ribière+ with restarts
 template<typename T>
-MatrixX<T> operator*(T v, const MatrixX<T>& m)
+struct ConjugateGradient: public Minimizer<T>
 {
-    MatrixX<T> out{m};
-    auto matrix_size{m.size()};
-    for (int i = 0; i < matrix_size; ++i) {
-        out.at(i) *= v;
-    }
-    return out;
-}
+    ConjugateGradient(int n, const Options<T>& opt = Options<T>{})
+        : Minimizer<T>(n, opt), last_g_(n, 1)
+    {}
+
+    template<typename F>
+    Result<T> minimize(F&& f, MatrixX<T>& x) { NullObserver obs; return minimize(std::forward<F>(f), x, obs); }
+    template<typename F, typename O>
+    Result<T> minimize(F&& f, MatrixX<T>& x, O& obs);
+private:
+    MatrixX<T> last_g_;
+}; // struct ConjugateGradient
 
 template<typename T>
-bool MatrixX<T>::is_pd_psd(bool psd) const
+template<typename F, typename O>
+Result<T> ConjugateGradient<T>::minimize(F&& f, MatrixX<T>& x, O& obs)
 {
-    // Sylvester's criterion
-    assert(col() == row());
+    auto& g{this->g_};
+    auto& d{this->d_};
+    QS_ASSERT(x.size() == g.size());
 
-    for (int i = 0; i < col(); ++i) {
-        T d{sub(i, i, row() - i, col() - i).det()};
-        if (d < 0 || (!psd && d == 0)) {
-            return false;
+    Result<T> result;
+    int evals{1};
+    T fx{f(static_cast<const MatrixX<T>&>(x), g)};
+    T last_fx{fx};
+    T step{1 / std::max(norm_inf(g), T{1})};
+    T last_slope{0};
+    for (int i = 0; i < d.size(); ++i) d.at(i) = -g.at(i);
+    for (int iter = 0; !this->stop(iter, evals, fx, last_fx, result, obs); ++iter) {
+        if (iter > 0) {
+            PhaseScope<O> scope(obs, Phase::solve);
+            const auto gg{dot(last_g_, last_g_)};
+            T beta{0};
+            for (int i = 0; i < g.size(); ++i) beta += g.at(i) * (g.at(i) - last_g_.at(i));
+            beta = std::max(T{0}, beta / gg);
+            for (int i = 0; i < d.size(); ++i) d.at(i) = beta * d.at(i) - g.at(i);
+            if (dot(g, d) >= 0) {
+                for (int i = 0; i < d.size(); ++i) d.at(i) = -g.at(i);
+            }
+        }
+        const auto slope{dot(g, d)};
+        if (iter > 0) step *= last_slope / slope;
+
+        last_g_ = g;
+        last_fx = fx;
+        if (!this->search(f, x, fx, step, evals, obs)) {
+            result.status = Status::line_search_failed;
+            break;
         }
+        last_slope = slope;
     }
-    return true;
+    return result;
 }
 
+// Limited memory BFGS, keeps the last `history` correction pairs (O(mn))
 template<typename T>
-bool MatrixX<T>::is_sym() const
+struct LBFGS: public Minimizer<T>
 {
-    if (row() != col()) return false;
-    if (row() == 1) return true;
+    LBFGS(int n, const Options<T>& opt = Options<T>{});
 
-    for (int r = 0; r < row(); ++r) {
-        for (int c = r + 1; c < col(); ++c) {
-            if (at(r, c) != at(c, r)) return false;
-        }
-    }
-    return true;
+    template<typename F>
+    Result<T> minimize(F&& f, MatrixX<T>& x) { NullObserver obs; return minimize(std::forward<F>(f), x, obs); }
+    template<typename F, typename O>
+    Result<T> minimize(F&& f, MatrixX<T>& x, O& obs);
+private:
+    // d = -H * g with the two-loop recursion
+    void direction();
+
+    std::vector<MatrixX<T>> s_;
+    std::vector<MatrixX<T>> y_;
+    std::vector<T> rho_;
+    std::vector<T> alpha_;
+    MatrixX<T> last_x_;
+    MatrixX<T> last_g_;
+    int head_;
+    int count_;
+}; // struct LBFGS
+
+template<typename T>
+LBFGS<T>::LBFGS(int n, const Options<T>& opt)
+    : Minimizer<T>(n, opt)
+    , s_(opt.history, MatrixX<T>(n, 1))
+    , y_(opt.history, MatrixX<T>(n, 1))
+    , rho_(opt.history)
+    , alpha_(opt.history)
+    , last_x_(n, 1)
+    , last_g_(n, 1)
+    , head_(0)
+    , count_(0)
+{
+    QS_ASSERT(opt.history > 0);
 }
 
 template<typename T>
-std::ostream& operator<<(std::ostream& os, const MatrixX<T>& m)
+void LBFGS<T>::direction()
 {
-    os << "Matrix" << typeid(T).name() << "<" << m.row() << ", " << m.col() << ">{";
-    os << std::fixed << std::setprecision(QS_PRINT_PRECISION);
-    for (int i = 0; i < m.size(); ++i) {
-        if (i % m.col() == 0) { os << "\n  "; }
-        os << m.at(i) << ", ";
+    auto& d{this->d_};
+    const auto m{static_cast<int>(s_.size())};
+    for (int i = 0; i < d.size(); ++i) d.at(i) = -this->g_.at(i);
+
+    for (int k = 0; k < count_; ++k) {
+        const auto j{(head_ - 1 - k + m) % m};
+        alpha_[j] = rho_[j] * dot(s_[j], d);
+        axpy_(d, -alpha_[j], y_[j]);
+    }
+    if (count_ > 0) {
+        const auto j{(head_ - 1 + m) % m};
+        const auto gamma{dot(s_[j], y_[j]) / dot(y_[j], y_[j])};
+        for (int i = 0; i < d.size(); ++i) d.at(i) *= gamma;
+    }
+    for (int k = count_ - 1; k >= 0; --k) {
+        const auto j{(head_ - 1 - k + m) % m};
+        const auto beta{rho_[j] * dot(y_[j], d)};
+        axpy_(d, alpha_[j] - beta, s_[j]);
     }
-    os << "\n}";
-    return os;
 }
 
 template<typename T>
-std::ostream& operator<<(std::ostream& os, const Array<T>& a)
+template<typename F, typename O>
+Result<T> LBFGS<T>::minimize(F&& f, MatrixX<T>& x, O& obs)
 {
-    os << "Array" << typeid(T).name() << "<" << a.size() << ">{";
-    os << std::fixed << std::setprecision(QS_PRINT_PRECISION);
-    const auto array_size{a.size()};
-    for (int i = 0; i < array_size; ++i) {
-        os << a.at(i);
-        if (i != array_size - 1) os << ", ";
+    auto& g{this->g_};
+    QS_ASSERT(x.size() == g.size());
+    const auto m{static_cast<int>(s_.size())};
+    head_ = 0;
+    count_ = 0;
+
+    Result<T> result;
+    int evals{1};
+    T fx{f(static_cast<const MatrixX<T>&>(x), g)};
+    T last_fx{fx};
+    for (int iter = 0; !this->stop(iter, evals, fx, last_fx, result, obs); ++iter) {
+        last_x_ = x;
+        last_g_ = g;
+        last_fx = fx;
+        bool moved;
+        for (;;) {
+            {
+                PhaseScope<O> scope(obs, Phase::solve);
+                direction();
+            }
+            // the first step is scaled, afterwards the unit step is tried first
+            T step{count_ > 0 ? T{1} : 1 / std::max(norm_inf(g), T{1})};
+            moved = this->search(f, x, fx, step, evals, obs);
+            if (moved || count_ == 0) break;
+            // a failed search restores x, drop the curvature history and
+            // retry along -g within the same iteration
+            count_ = 0;
+        }
+        if (!moved) {
+            result.status = Status::line_search_failed;
+            break;
+        }
+
+        auto& s{s_[head_]};
+        auto& y{y_[head_]};
+        for (int i = 0; i < x.size(); ++i) {
+            s.at(i) = x.at(i) - last_x_.at(i);
+            y.at(i) = g.at(i) - last_g_.at(i);
+        }
+        const auto sy{dot(s, y)};
+        if (sy > std::numeric_limits<T>::epsilon() * dot(y, y)) {
+            rho_[head_] = 1 / sy;
+            head_ = (head_ + 1) % m;
+            count_ = std::min(count_ + 1, m);
+        }
     }
-    os << "}";
-    return os;
+    return result;
 }
 
+} // namespace optim
+
 } // namespace qs
 
 #endif // QS_HPP_
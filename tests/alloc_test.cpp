@@ -0,0 +1,99 @@
+#include <mutex>
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+bool all_equal(const qs::MatrixXf& m, float v)
+{
+    for (int i = 0; i < m.size(); ++i) {
+        if (m.at(i) != v) return false;
+    }
+    return true;
+}
+
+HT_CASE(Alloc, uninitialized)
+{
+    qs::MatrixXf m(300, 200, qs::uninitialized);
+    HT_ASSERT_TRUE(m.row() == 300 && m.col() == 200 && m.size() == 60000)
+    m.fill_1_();
+    HT_ASSERT_TRUE(all_equal(m, 1.0f))
+
+    qs::Array<double> small(3, qs::uninitialized);
+    HT_ASSERT_TRUE(small.size() == 3)
+}
+
+HT_CASE(Alloc, huge_pages)
+{
+    const auto saved{qs::alloc_policy()};
+    // parallel first touch is opt in
+    HT_ASSERT_TRUE(saved.parallel_touch_bytes == std::numeric_limits<std::size_t>::max())
+    qs::set_num_threads(4);
+    for (auto mode : {qs::HugePages::none, qs::HugePages::transparent, qs::HugePages::explicit_pages}) {
+        auto policy{saved};
+        policy.huge_pages = mode;
+        policy.huge_bytes = 1 << 20;
+        policy.parallel_touch_bytes = 1 << 16;
+        qs::set_alloc_policy(policy);
+
+        // 4 MiB, zero filled in parallel ranges
+        qs::MatrixXf big(1024, 1024);
+        HT_ASSERT_TRUE(all_equal(big, 0.0f))
+        HT_ASSERT_TRUE(reinterpret_cast<std::uintptr_t>(big.data()) % 64 == 0)
+        big.fill_1_();
+        auto copy{big};
+        HT_ASSERT_TRUE(all_equal(copy, 1.0f))
+
+        // freed under another policy than the one it was allocated with
+        qs::set_alloc_policy(saved);
+        big.resize_(8, 8);
+        HT_ASSERT_TRUE(all_equal(big, 1.0f))
+    }
+    qs::set_alloc_policy(saved);
+}
+
+HT_CASE(Alloc, first_touch_follows_gemm)
+{
+    // the touch hands out the same row ranges, on the same pinned CPUs, as
+    // the threaded gemm
+    const auto saved_policy{qs::alloc_policy()};
+    const auto saved_tuning{qs::tuning()};
+    auto policy{saved_policy};
+    policy.parallel_touch_bytes = 1;
+    qs::set_alloc_policy(policy);
+    auto t{saved_tuning};
+    t.gemm_mc = 16;
+    t.parallel_flops = 1;
+    qs::set_tuning(t);
+    qs::set_num_threads(4);
+    qs::set_pin_threads(true);
+
+    const int m{150}, k{40}, n{30};
+    std::mutex lock;
+    std::vector<std::pair<int, int>> touched, computed;
+    std::vector<int> touch_cpu(m, -1), gemm_cpu(m, -2);
+    qs::detail::first_touch<float>(m, n, [&] (int b, int e) {
+        std::lock_guard<std::mutex> guard(lock);
+        touched.emplace_back(b / n, e / n);
+        for (int i = b / n; i < e / n; ++i) touch_cpu[i] = sched_getcpu();
+    });
+    qs::detail::gemm_rows(m, k, n, [&] (int i0, int i1) {
+        std::lock_guard<std::mutex> guard(lock);
+        computed.emplace_back(i0, i1);
+        for (int i = i0; i < i1; ++i) gemm_cpu[i] = sched_getcpu();
+    });
+    std::sort(touched.begin(), touched.end());
+    std::sort(computed.begin(), computed.end());
+    HT_ASSERT_TRUE(touched.size() == 4 && touched == computed)
+    // the calling thread keeps the last range and is not pinned
+    HT_ASSERT_TRUE(std::equal(touch_cpu.begin(), touch_cpu.begin() + computed.back().first, gemm_cpu.begin()))
+
+    qs::MatrixXf a(m, k), b(k, n);
+    a.fill_uniform_(-1.0f, 1.0f, qs::Philox(9));
+    b.fill_uniform_(-1.0f, 1.0f, qs::Philox(9, 1));
+    const auto c{a * b};
+    qs::set_pin_threads(false);
+    qs::set_alloc_policy(saved_policy);
+    qs::set_tuning(saved_tuning);
+    HT_ASSERT_TRUE(c == a * b)
+}
@@ -0,0 +1,118 @@
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+template<typename T>
+bool near(const qs::MatrixX<T>& a, const qs::MatrixX<T>& b, T eps = 1.0e-4)
+{
+    if (a.row() != b.row() || a.col() != b.col()) return false;
+    for (int i = 0; i < a.size(); ++i) {
+        if (std::abs(a.at(i) - b.at(i)) > eps) return false;
+    }
+    return true;
+}
+
+HT_CASE(AD, quadratic_grad)
+{
+    qs::Matrixd<3, 3> A;
+    qs::Vectord<3> x;
+    A << 8, 2, 3,
+         2, 9, 5,
+         3, 5, 6;
+    x << 4.0, 6.0, 9.0;
+
+    qs::MatrixXd g(3, 1);
+    auto fx{qs::ad::gradient([&](const auto& x) { return x.t() * A * x; }, qs::MatrixXd{x}, g)};
+
+    HT_ASSERT_TRUE(std::abs(fx - (x.t() * A * x).scalar()) < 1.0e-9)
+    HT_ASSERT_TRUE(near<double>(g, (A + A.t()) * x))
+}
+
+HT_CASE(AD, quadratic_hvp)
+{
+    qs::Matrixd<3, 3> A;
+    qs::Vectord<3> x;
+    qs::Vectord<3> v;
+    A << 8, 2, 3,
+         2, 9, 5,
+         3, 5, 6;
+    x << 4.0, 6.0, 9.0;
+    v << 1.0, -2.0, 0.5;
+
+    auto hv{qs::ad::hvp([&](const auto& x) { return x.t() * A * x; }, qs::MatrixXd{x}, qs::MatrixXd{v})};
+    HT_ASSERT_TRUE(near<double>(hv, (A + A.t()) * v))
+}
+
+HT_CASE(AD, elementwise_grad)
+{
+    // f(x) = sum(exp(x)) + ‖x‖₂ + 0.5 ‖x‖₁
+    qs::Vectord<3> x;
+    qs::Vectord<3> v;
+    x << 0.5, -1.0, 2.0;
+    v << 1.0, 1.0, -1.0;
+    auto f{[] (const auto& x) { return x.exp().sum() + x.norm2() + 0.5 * x.norm1(); }};
+
+    qs::MatrixXd g(3, 1);
+    qs::ad::gradient(f, qs::MatrixXd{x}, g);
+    const auto n{x.norm2()};
+    qs::MatrixXd expected(3, 1);
+    for (int i = 0; i < 3; ++i) {
+        expected.at(i) = std::exp(x.at(i)) + x.at(i) / n + 0.5 * (x.at(i) > 0 ? 1 : -1);
+    }
+    HT_ASSERT_TRUE(near<double>(g, expected))
+
+    // compare H * v against central differences of the gradient
+    const double h{1.0e-5};
+    qs::MatrixXd gp(3, 1);
+    qs::MatrixXd gm(3, 1);
+    qs::ad::gradient(f, qs::MatrixXd{x + v * h}, gp);
+    qs::ad::gradient(f, qs::MatrixXd{x - v * h}, gm);
+    auto hv{qs::ad::hvp(f, qs::MatrixXd{x}, qs::MatrixXd{v})};
+    HT_ASSERT_TRUE(near<double>(hv, (gp - gm) * (0.5 / h)))
+}
+
+HT_CASE(AD, tape_reuse)
+{
+    qs::ad::Tape<float> tape;
+    qs::Vectorf<2> x;
+    x << 1.0f, 2.0f;
+    qs::MatrixXf g(2, 1);
+    auto f{[] (const auto& x) { return x.square().sum(); }};
+
+    tape.gradient(f, x, g);
+    const auto capacity{tape.arena().capacity()};
+    for (int i = 0; i < 10; ++i) tape.gradient(f, x, g);
+
+    HT_ASSERT_TRUE(tape.arena().capacity() == capacity)
+    HT_ASSERT_TRUE(g.at(0) == 2.0f && g.at(1) == 4.0f)
+}
+
+HT_CASE(AD, blocked_products)
+{
+    // products large enough to cross the gemm blocks and threads, f(x) =
+    // ‖Ax‖², grad 2AᵀAx, Hv 2AᵀAv
+    const auto saved{qs::tuning()};
+    auto t{saved};
+    t.gemm_mc = 16;
+    t.gemm_kc = 32;
+    t.gemm_nc = 24;
+    t.parallel_flops = 1;
+    qs::set_tuning(t);
+    qs::set_num_threads(3);
+
+    qs::MatrixXd A(120, 90), x(90, 1), v(90, 1);
+    A.fill_uniform_(-1.0, 1.0, qs::Philox(11));
+    x.fill_uniform_(-1.0, 1.0, qs::Philox(11, 1));
+    v.fill_uniform_(-1.0, 1.0, qs::Philox(11, 2));
+    auto f{[&] (const auto& x) { return (A * x).square().sum(); }};
+
+    qs::MatrixXd g(90, 1);
+    const auto fx{qs::ad::gradient(f, x, g)};
+    const auto hv{qs::ad::hvp(f, x, v)};
+    const auto AtA{A.t() * A};
+    qs::set_tuning(saved);
+    HT_ASSERT_TRUE(std::abs(fx - (A * x).norm2() * (A * x).norm2()) < 1.0e-9 * fx)
+    HT_ASSERT_TRUE(near<double>(g, 2.0 * (AtA * x), 1.0e-9))
+    HT_ASSERT_TRUE(near<double>(hv, 2.0 * (AtA * v), 1.0e-9))
+}
@@ -0,0 +1,103 @@
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+HT_CASE(Broadcast, vectors)
+{
+    qs::Matrixd<2, 3> m;
+    m << 1, 2, 3,
+         4, 5, 6;
+    qs::Matrixd<1, 3> r;
+    r << 10, 20, 30;
+    qs::Matrixd<2, 1> c;
+    c << 100, 200;
+
+    const auto a{m + r};
+    HT_ASSERT_TRUE(a.row() == 2 && a.col() == 3)
+    HT_ASSERT_TRUE(a(0, 0) == 11 && a(1, 2) == 36)
+    const auto b{c - m};
+    HT_ASSERT_TRUE(b(0, 2) == 97 && b(1, 0) == 196)
+    const auto e{m.emul(c)};
+    HT_ASSERT_TRUE(e(0, 1) == 200 && e(1, 1) == 1000)
+    const auto d{m.ediv(r)};
+    HT_ASSERT_TRUE(d(1, 0) == 0.4 && d(1, 2) == 0.2)
+
+    // outer broadcast of a column against a row
+    const auto o{c + r};
+    HT_ASSERT_TRUE(o.row() == 2 && o.col() == 3 && o(1, 2) == 230)
+
+    qs::MatrixXd one{1, 1};
+    one(0, 0) = 2;
+    HT_ASSERT_TRUE(m.emul(one) == m * 2.0)
+    HT_ASSERT_TRUE((m + 1.0)(1, 1) == 6 && (1.0 - m)(1, 1) == -4 && (m / 2.0)(0, 1) == 1)
+}
+
+HT_CASE(Broadcast, reductions)
+{
+    qs::Matrixd<2, 3> m;
+    m << 1, -2, 3,
+         4, 5, -6;
+
+    const auto rs{m.rowwise().sum()};
+    HT_ASSERT_TRUE(rs.row() == 2 && rs.col() == 1 && rs(0, 0) == 2 && rs(1, 0) == 3)
+    const auto cs{m.colwise().sum()};
+    HT_ASSERT_TRUE(cs.row() == 1 && cs.col() == 3 && cs(0, 0) == 5 && cs(0, 2) == -3)
+    HT_ASSERT_TRUE(m.colwise().mean()(0, 1) == 1.5)
+    HT_ASSERT_TRUE(m.rowwise().max()(0, 0) == 3 && m.colwise().max()(0, 2) == 3)
+    HT_ASSERT_TRUE(std::abs(m.rowwise().norm()(0, 0) - std::sqrt(14.0)) < 1e-12)
+    HT_ASSERT_TRUE(std::abs(m.colwise().norm()(0, 0) - std::sqrt(17.0)) < 1e-12)
+}
+
+HT_CASE(Broadcast, standardize)
+{
+    qs::MatrixXf x{500, 7};
+    x.fill_normal_(3.0f, 2.0f);
+    const auto centered{x - x.colwise().mean()};
+    const auto scale{centered.colwise().norm() / std::sqrt(static_cast<float>(x.row()))};
+    const auto z{centered.ediv(scale)};
+
+    const auto mean{z.colwise().mean()};
+    const auto var{z.emul(z).colwise().mean()};
+    for (int j = 0; j < z.col(); ++j) {
+        HT_ASSERT_TRUE(std::abs(mean(0, j)) < 1e-4f)
+        HT_ASSERT_TRUE(std::abs(var(0, j) - 1.0f) < 1e-4f)
+    }
+}
+
+HT_CASE(Broadcast, half)
+{
+    qs::MatrixXf x{4, 40};
+    x.fill_uniform_(-1.0f, 1.0f);
+    qs::MatrixXf r{1, 40};
+    r.fill_uniform_(-1.0f, 1.0f);
+    const auto h{qs::convert<qs::fp16>(x) + qs::convert<qs::fp16>(r)};
+    const auto f{x + r};
+    for (int i = 0; i < f.size(); ++i) {
+        HT_ASSERT_TRUE(std::abs(static_cast<float>(h.at(i)) - f.at(i)) < 2e-3f)
+    }
+    const auto s{qs::convert<qs::fp16>(x).rowwise().sum()};
+    const auto fs{x.rowwise().sum()};
+    for (int i = 0; i < x.row(); ++i) {
+        HT_ASSERT_TRUE(std::abs(static_cast<float>(s(i, 0)) - fs(i, 0)) < 0.05f)
+    }
+}
+
+HT_CASE(Broadcast, parallel_and_temporaries)
+{
+    qs::MatrixXd x{20000, 64};
+    for (int i = 0; i < x.size(); ++i) x.at(i) = (i * 7) % 13 - 6;
+
+    qs::set_num_threads(1);
+    const auto serial_cols{x.colwise().sum()};
+    const auto serial_rows{x.rowwise().max()};
+    qs::set_num_threads(4);
+    HT_ASSERT_TRUE(x.colwise().sum() == serial_cols)
+    HT_ASSERT_TRUE(x.rowwise().max() == serial_rows)
+    HT_ASSERT_TRUE(x.colwise().max() == qs::MatrixXd(1, 64) + 6.0)
+
+    // a view of a temporary owns it
+    auto view{(x - x.colwise().mean()).colwise()};
+    const auto centered{view.mean()};
+    for (int j = 0; j < centered.col(); ++j) HT_ASSERT_TRUE(std::abs(centered(0, j)) < 1e-12)
+}
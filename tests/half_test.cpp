@@ -0,0 +1,126 @@
+#include <vector>
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+HT_CASE(Half, scalar_conversion)
+{
+    HT_ASSERT_TRUE(qs::fp16(1.0f).bits == 0x3c00 && qs::bf16(1.0f).bits == 0x3f80)
+    HT_ASSERT_TRUE(qs::fp16(-2.0f).bits == 0xc000 && qs::bf16(-2.0f).bits == 0xc000)
+    HT_ASSERT_TRUE(qs::fp16(65504.0f).bits == 0x7bff && qs::fp16(65520.0f).bits == 0x7c00)
+    HT_ASSERT_TRUE(qs::fp16(std::ldexp(1.0f, -24)).bits == 0x0001 && qs::fp16(std::ldexp(1.0f, -25)).bits == 0)
+    // ties go to even: 1 + 2^-11 is half way between 1 and 1 + 2^-10
+    HT_ASSERT_TRUE(qs::fp16(1.0f + std::ldexp(1.0f, -11)).bits == 0x3c00)
+    HT_ASSERT_TRUE(qs::fp16(1.0f + 3 * std::ldexp(1.0f, -11)).bits == 0x3c02)
+    HT_ASSERT_TRUE(qs::bf16(1.0f + std::ldexp(1.0f, -8)).bits == 0x3f80)
+    HT_ASSERT_TRUE(qs::bf16(1.0f + 3 * std::ldexp(1.0f, -8)).bits == 0x3f82)
+    HT_ASSERT_TRUE(std::isnan(float(qs::fp16(std::nanf("")))) && std::isnan(float(qs::bf16(std::nanf("")))))
+    HT_ASSERT_TRUE(std::isinf(float(qs::bf16(std::numeric_limits<float>::infinity()))))
+
+    // every non NaN half survives a round trip through float
+    bool exact{true};
+    for (int b = 0; b < 0x10000; ++b) {
+        const auto h{qs::fp16::from_bits(static_cast<std::uint16_t>(b))};
+        const auto g{qs::bf16::from_bits(static_cast<std::uint16_t>(b))};
+        if (!std::isnan(float(h))) exact = exact && qs::fp16(float(h)).bits == h.bits;
+        if (!std::isnan(float(g))) exact = exact && qs::bf16(float(g)).bits == g.bits;
+    }
+    HT_ASSERT_TRUE(exact)
+}
+
+HT_CASE(Half, bulk_conversion)
+{
+    const int n{1000};
+    qs::MatrixXf f(n, 1);
+    f.fill_normal_(0.0f, 100.0f, qs::Philox(5));
+    auto h{qs::convert<qs::fp16>(f)};
+    auto g{qs::convert<qs::bf16>(f)};
+    bool same{true};
+    for (int i = 0; i < n; ++i) {
+        same = same && h.at(i).bits == qs::fp16(f.at(i)).bits && g.at(i).bits == qs::bf16(f.at(i)).bits;
+    }
+    HT_ASSERT_TRUE(same)
+
+    auto back{qs::convert<float>(h)};
+    bool close{true};
+    for (int i = 0; i < n; ++i) close = close && back.at(i) == float(h.at(i));
+    HT_ASSERT_TRUE(close)
+}
+
+HT_CASE(Half, fill_normal)
+{
+    // the normals are computed in float and rounded once, so they match
+    // rounding a float fill drawn from the same stream
+    const int n{1001};
+    qs::MatrixXf f(n, 1);
+    qs::MatrixX<qs::fp16> h(n, 1);
+    qs::MatrixX<qs::bf16> g(n, 1);
+    f.fill_normal_(1.0f, 2.0f, qs::Philox(7));
+    h.fill_normal_(qs::fp16(1.0f), qs::fp16(2.0f), qs::Philox(7));
+    g.fill_normal_(qs::bf16(1.0f), qs::bf16(2.0f), qs::Philox(7));
+    bool same{true};
+    float sum{0.0f};
+    for (int i = 0; i < n; ++i) {
+        same = same && h.at(i).bits == qs::fp16(f.at(i)).bits && g.at(i).bits == qs::bf16(f.at(i)).bits;
+        sum += float(h.at(i));
+    }
+    HT_ASSERT_TRUE(same)
+    HT_ASSERT_TRUE(std::abs(sum / n - 1.0f) < 0.2f)
+}
+
+HT_CASE(Half, kernels)
+{
+    const int m{37}, k{300};
+    qs::MatrixXf fa(m, k), fx(k, 1), fb(m, k);
+    fa.fill_uniform_(-1.0f, 1.0f, qs::Philox(6));
+    fb.fill_uniform_(-1.0f, 1.0f, qs::Philox(6, 1));
+    fx.fill_uniform_(-1.0f, 1.0f, qs::Philox(6, 2));
+    for (auto eps : {1.0e-3f, 1.0e-2f}) {
+        const bool is_bf16{eps > 1.0e-3f};
+        // reference on the rounded inputs, so only accumulation differs
+        auto a_h{qs::convert<qs::fp16>(fa)};
+        auto b_h{qs::convert<qs::fp16>(fb)};
+        auto a_g{qs::convert<qs::bf16>(fa)};
+        auto b_g{qs::convert<qs::bf16>(fb)};
+        auto a{is_bf16 ? qs::convert<float>(a_g) : qs::convert<float>(a_h)};
+        auto b{is_bf16 ? qs::convert<float>(b_g) : qs::convert<float>(b_h)};
+
+        auto y{is_bf16 ? qs::gemv(a_g, fx) : qs::gemv(a_h, fx)};
+        auto y_ref{a * fx};
+        bool ok{true};
+        for (int i = 0; i < m; ++i) ok = ok && std::abs(y.at(i) - y_ref.at(i)) < 1.0e-4f;
+
+        auto sum{is_bf16 ? qs::convert<float>(a_g + b_g) : qs::convert<float>(a_h + b_h)};
+        auto scaled{is_bf16 ? qs::convert<float>(a_g * qs::bf16(0.5f)) : qs::convert<float>(a_h * qs::fp16(0.5f))};
+        auto ref_sum{a + b};
+        for (int i = 0; i < a.size(); ++i) {
+            ok = ok && std::abs(sum.at(i) - ref_sum.at(i)) <= eps * std::abs(ref_sum.at(i)) + 1.0e-6f;
+            ok = ok && scaled.at(i) == 0.5f * a.at(i);
+        }
+
+        auto c{is_bf16 ? qs::convert<float>(a_g * b_g.t()) : qs::convert<float>(a_h * b_h.t())};
+        auto c_ref{a * b.t()};
+        for (int i = 0; i < c.size(); ++i) ok = ok && std::abs(c.at(i) - c_ref.at(i)) <= eps * std::abs(c_ref.at(i)) + 1.0e-3f;
+        HT_ASSERT_TRUE(ok)
+    }
+
+    auto v{qs::convert<qs::bf16>(fx)};
+    HT_ASSERT_TRUE(std::abs(v.norm2() - fx.norm2()) < 1.0e-2f * fx.norm2())
+
+    // panels are converted tile by tile, any blocking sums in the same order
+    const auto a_h{qs::convert<qs::fp16>(fa)};
+    const auto b_h{qs::convert<qs::fp16>(fb).t()};
+    const auto whole{a_h * b_h};
+    const auto saved{qs::tuning()};
+    auto small{saved};
+    small.gemm_mc = 8;
+    small.gemm_kc = 48;
+    small.gemm_nc = 16;
+    qs::set_tuning(small);
+    const auto tiled{a_h * b_h};
+    qs::set_tuning(saved);
+    bool same{true};
+    for (int i = 0; i < whole.size(); ++i) same = same && whole.at(i).bits == tiled.at(i).bits;
+    HT_ASSERT_TRUE(same)
+}
@@ -0,0 +1,137 @@
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+bool near(const qs::MatrixXd& a, const qs::MatrixXd& b, double eps = 1.0e-9)
+{
+    if (a.row() != b.row() || a.col() != b.col()) return false;
+    for (int i = 0; i < a.size(); ++i) {
+        if (std::abs(a.at(i) - b.at(i)) > eps) return false;
+    }
+    return true;
+}
+
+// well conditioned spd matrix M M^T + n I
+qs::MatrixXd spd(int n, std::uint64_t stream)
+{
+    qs::MatrixXd m(n, n);
+    m.fill_uniform_(-1.0, 1.0, qs::Philox(7, stream));
+    return m * m.t() + qs::DiagonalMatrix<double>::identity(n) * static_cast<double>(n);
+}
+
+HT_CASE(LowRank, cholesky)
+{
+    const int n{6};
+    auto a{spd(n, 0)};
+    qs::MatrixXd v(n, 2);
+    v.fill_uniform_(-1.0, 1.0, qs::Philox(7, 1));
+    qs::MatrixXd b(n, 1);
+    b.fill_uniform_(-1.0, 1.0, qs::Philox(7, 2));
+
+    qs::Cholesky<double> f(a);
+    HT_ASSERT_TRUE(f.ok())
+    HT_ASSERT_TRUE(near(f.l() * f.l().t(), a))
+    HT_ASSERT_TRUE(near(a * f.solve(b), b))
+    HT_ASSERT_TRUE(std::abs(f.det() - a.det()) < 1.0e-6 * std::abs(a.det()))
+
+    HT_ASSERT_TRUE(f.update_(v))
+    auto up{a + v * v.t()};
+    HT_ASSERT_TRUE(near(f.l(), qs::Cholesky<double>(up).l()))
+    HT_ASSERT_TRUE(near(up * f.solve(b), b))
+
+    HT_ASSERT_TRUE(f.downdate_(v))
+    HT_ASSERT_TRUE(near(f.l(), qs::Cholesky<double>(a).l()))
+
+    // a - w w^T is indefinite, the factor is kept
+    qs::MatrixXd w(n, 1);
+    w.fill_0_();
+    w.at(0) = 2 * std::sqrt(a(0, 0));
+    const auto before{f.l()};
+    HT_ASSERT_FALSE(f.downdate_(w))
+    HT_ASSERT_TRUE(f.l() == before)
+
+    qs::MatrixXd indefinite{a};
+    indefinite(2, 2) = -1.0;
+    HT_ASSERT_FALSE(qs::Cholesky<double>(indefinite).ok())
+}
+
+HT_CASE(LowRank, ldlt)
+{
+    const int n{5};
+    auto a{spd(n, 3)};
+    qs::MatrixXd v(n, 3);
+    v.fill_uniform_(-1.0, 1.0, qs::Philox(7, 4));
+    qs::MatrixXd b(n, 2);
+    b.fill_uniform_(-1.0, 1.0, qs::Philox(7, 5));
+
+    qs::LDLT<double> f(a);
+    HT_ASSERT_TRUE(f.ok())
+    HT_ASSERT_TRUE(near(a * f.solve(b), b))
+
+    HT_ASSERT_TRUE(f.update_(v, 0.5))
+    auto up{a + v * v.t() * 0.5};
+    qs::LDLT<double> ref(up);
+    HT_ASSERT_TRUE(near(f.l(), ref.l()))
+    HT_ASSERT_TRUE(near(up * f.solve(b), b))
+    HT_ASSERT_TRUE(std::abs(f.det() - up.det()) < 1.0e-6 * std::abs(up.det()))
+
+    HT_ASSERT_TRUE(f.update_(v, -0.5))
+    HT_ASSERT_TRUE(near(a * f.solve(b), b))
+
+    // a - w w^T is indefinite, the factor is kept
+    qs::MatrixXd w(n, 1);
+    w.fill_0_();
+    w.at(0) = 2 * std::sqrt(a(0, 0));
+    const auto before{f.d()};
+    HT_ASSERT_FALSE(f.downdate_(w))
+    HT_ASSERT_TRUE(f.d() == before)
+}
+
+HT_CASE(LowRank, woodbury)
+{
+    const int n{6};
+    auto a{spd(n, 6)};
+    qs::MatrixXd u(n, 2), v(n, 2);
+    u.fill_uniform_(-1.0, 1.0, qs::Philox(7, 7));
+    v.fill_uniform_(-1.0, 1.0, qs::Philox(7, 8));
+    qs::MatrixXd b(n, 1);
+    b.fill_uniform_(-1.0, 1.0, qs::Philox(7, 9));
+    const auto expected{(a + u * v.t()).inv()};
+
+    auto a_inv{a.inv()};
+    qs::woodbury_(a_inv, u, v);
+    HT_ASSERT_TRUE(near(a_inv, expected, 1.0e-8))
+
+    a_inv = a.inv();
+    HT_ASSERT_TRUE(qs::sherman_morrison_(a_inv, u.sub(0, 0, n, 1), v.sub(0, 0, n, 1)))
+    HT_ASSERT_TRUE(qs::sherman_morrison_(a_inv, u.sub(0, 1, n, 1), v.sub(0, 1, n, 1)))
+    HT_ASSERT_TRUE(near(a_inv, expected, 1.0e-8))
+
+    qs::Cholesky<double> f(a);
+    HT_ASSERT_TRUE(near(qs::woodbury_solve(f, u, v, b), expected * b, 1.0e-8))
+
+    // singular rank one update of the identity
+    auto eye{qs::MatrixXd::eye(2)};
+    qs::MatrixXd e(2, 1);
+    e << 1, 0;
+    HT_ASSERT_FALSE(qs::sherman_morrison_(eye, e, e * -1.0))
+    HT_ASSERT_TRUE(eye == qs::MatrixXd::eye(2))
+}
+
+HT_CASE(LowRank, eigen_shift)
+{
+    const int n{7};
+    auto a{spd(n, 10)};
+    qs::SymmetricEigen<double> eig(a);
+    const auto& q{eig.vectors()};
+    HT_ASSERT_TRUE(near(q.t() * q, qs::MatrixXd::eye(n)))
+
+    qs::MatrixXd b(n, 2);
+    b.fill_uniform_(-1.0, 1.0, qs::Philox(7, 11));
+    for (double shift : {0.0, 0.1, 3.0}) {
+        auto shifted{a + qs::DiagonalMatrix<double>::identity(n) * shift};
+        HT_ASSERT_TRUE(near(shifted * eig.solve(b, shift), b))
+        HT_ASSERT_TRUE(near(eig.inv(shift), shifted.inv()))
+    }
+}
@@ -0,0 +1,110 @@
+#include <vector>
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+HT_CASE(Map, write_through)
+{
+    std::vector<double> buf{1, 2, 3, 4, 5, 6};
+    qs::Map<double> m(buf.data(), 2, 3);
+    HT_ASSERT_TRUE(m.is_borrowed())
+    HT_ASSERT_TRUE(m.data() == buf.data())
+    HT_ASSERT_TRUE(m(1, 2) == 6.0)
+
+    m(0, 0) = 10.0;
+    m = m * 2.0;
+    HT_ASSERT_TRUE(buf[0] == 20.0 && buf[5] == 12.0)
+
+    qs::MatrixXd ones(2, 3);
+    ones.fill_1_();
+    m = ones;
+    HT_ASSERT_TRUE(buf[0] == 1.0 && buf[5] == 1.0 && m.data() == buf.data())
+
+    // copies of the base are owning
+    qs::MatrixXd owned{m};
+    HT_ASSERT_FALSE(owned.is_borrowed())
+    owned.at(0) = 7.0;
+    HT_ASSERT_TRUE(buf[0] == 1.0)
+
+    // copies and moves of the map still point at the buffer
+    qs::Map<double> alias{m};
+    qs::Map<double> moved{std::move(alias)};
+    moved.at(1) = 3.0;
+    HT_ASSERT_TRUE(buf[1] == 3.0 && moved.data() == buf.data())
+}
+
+HT_CASE(Map, kernels)
+{
+    std::vector<double> a{1, 2, 3, 4};
+    std::vector<double> b{5, 6, 7, 8};
+    qs::Map<const double> ma(a.data(), 2, 2);
+    qs::Map<const double> mb(b.data(), 2, 2);
+    auto c{ma * mb};
+    HT_ASSERT_TRUE(c(0, 0) == 19.0 && c(0, 1) == 22.0 && c(1, 0) == 43.0 && c(1, 1) == 50.0)
+
+    std::vector<double> out(4);
+    qs::Map<double> mc(out.data(), 2, 2);
+    mc = ma + mb;
+    HT_ASSERT_TRUE(out[0] == 6.0 && out[3] == 12.0)
+
+    // a const map only binds where the matrix is read
+    static_assert(!std::is_convertible_v<qs::Map<const double>&, qs::MatrixXd&>);
+    static_assert(std::is_convertible_v<qs::Map<const double>&, const qs::MatrixXd&>);
+    HT_ASSERT_TRUE(qs::MatrixXd{ma}.t() == ma.t())
+
+    // a borrowed buffer can be reshaped in place, its size is fixed
+    mc.resize_(1, 4);
+    HT_ASSERT_TRUE(mc.row() == 1 && mc.col() == 4 && mc.data() == out.data())
+}
+
+// f(x) = |x - 1|^2
+double shifted(const qs::MatrixXd& x, qs::MatrixXd& g)
+{
+    double fx{0};
+    for (int i = 0; i < x.size(); ++i) {
+        fx += (x.at(i) - 1) * (x.at(i) - 1);
+        g.at(i) = 2 * (x.at(i) - 1);
+    }
+    return fx;
+}
+
+HT_CASE(Map, solver)
+{
+    std::vector<double> x(8, -3.0);
+    qs::Map<double> mx(x.data(), 8, 1);
+    qs::optim::LBFGS<double> solver(8);
+    auto result{solver.minimize(shifted, mx)};
+    HT_ASSERT_TRUE(result.status == qs::optim::Status::converged_grad)
+    for (auto v : x) HT_ASSERT_TRUE(std::abs(v - 1) < 1.0e-6)
+    HT_ASSERT_TRUE(mx.data() == x.data())
+}
+
+HT_CASE(Map, block)
+{
+    qs::MatrixXd m(3, 4);
+    m << 1, 2, 3, 4,
+         5, 6, 7, 8,
+         9, 10, 11, 12;
+    auto b{m.block(1, 1, 2, 2)};
+    HT_ASSERT_FALSE(b.is_contiguous())
+    HT_ASSERT_TRUE(b(0, 0) == 6.0 && b(1, 1) == 11.0)
+
+    auto e{b.eval()};
+    HT_ASSERT_TRUE(e.row() == 2 && e.col() == 2 && e(1, 0) == 10.0)
+
+    b.assign(e * 2.0);
+    HT_ASSERT_TRUE(m(1, 1) == 12.0 && m(2, 2) == 22.0 && m(0, 0) == 1.0 && m(2, 3) == 12.0)
+
+    auto bt{b.t()};
+    HT_ASSERT_TRUE(bt(0, 1) == 20.0)
+
+    qs::prox::box_(m.block(0, 0, 3, 1), 0.0, 5.0);
+    HT_ASSERT_TRUE(m(0, 0) == 1.0 && m(1, 0) == 5.0 && m(2, 0) == 5.0 && m(2, 1) == 20.0)
+
+    // full width rows are contiguous and can be mapped
+    const qs::MatrixXd& cm{m};
+    auto rows{cm.block(1, 0, 2, 4)};
+    HT_ASSERT_TRUE(rows.is_contiguous())
+    HT_ASSERT_TRUE(rows.map() == m.sub(1, 0, 2, 4))
+}
@@ -35,3 +35,74 @@ HT_CASE(Matrix, is_psd)
     HT_ASSERT_FALSE(zeros3x3.is_pd())
     HT_ASSERT_TRUE(zeros3x3.is_psd())
 }
+
+HT_CASE(Matrix, transpose)
+{
+    const int shapes[][2]{{1, 1}, {1, 7}, {7, 1}, {5, 5}, {67, 67}, {3, 5}, {70, 33}, {33, 70}, {128, 3}};
+    for (const auto& shape : shapes) {
+        qs::MatrixXi m(shape[0], shape[1]);
+        for (int i = 0; i < m.size(); ++i) m.at(i) = i;
+
+        auto out{m.t()};
+        auto in_place{m};
+        in_place.t_();
+
+        bool ok{out.row() == m.col() && out.col() == m.row()};
+        ok = ok && in_place.row() == m.col() && in_place.col() == m.row();
+        for (int r = 0; ok && r < m.row(); ++r) {
+            for (int c = 0; c < m.col(); ++c) {
+                ok = ok && out.at(c, r) == m.at(r, c) && in_place.at(c, r) == m.at(r, c);
+            }
+        }
+        HT_ASSERT_TRUE(ok)
+    }
+
+    qs::Matrixi<2, 2> fixed;
+    fixed << 1, 2,
+             3, 4;
+    fixed.t_();
+    HT_ASSERT_TRUE(fixed.at(0, 1) == 3 && fixed.at(1, 0) == 2)
+}
+
+HT_CASE(Array, small_buffer)
+{
+    const int inline_n{QS_ARRAY_INLINE_CAPACITY};
+    auto filled{[] (int n) {
+        qs::Array<double> a(n);
+        for (int i = 0; i < n; ++i) a.at(i) = i + 1;
+        return a;
+    }};
+    auto check{[] (const qs::Array<double>& a, int n) {
+        if (a.size() != n) return false;
+        for (int i = 0; i < n; ++i) {
+            if (a.at(i) != i + 1) return false;
+        }
+        return true;
+    }};
+
+    for (int n : {1, inline_n, inline_n + 1, 4 * inline_n}) {
+        auto a{filled(n)};
+        qs::Array<double> copied{a};
+        qs::Array<double> moved{std::move(copied)};
+        HT_ASSERT_TRUE(check(a, n) && check(moved, n))
+
+        // assignment across the inline/heap boundary both ways
+        auto small{filled(1)};
+        auto big{filled(4 * inline_n)};
+        small = a;
+        big = a;
+        HT_ASSERT_TRUE(check(small, n) && check(big, n))
+        auto small2{filled(1)};
+        auto big2{filled(4 * inline_n)};
+        small2 = filled(n);
+        big2 = filled(n);
+        HT_ASSERT_TRUE(check(small2, n) && check(big2, n))
+    }
+
+    qs::MatrixXd m(2, 2);
+    m << 1, 2, 3, 4;
+    m.resize_(8, 8);
+    HT_ASSERT_TRUE(m.row() == 8 && m.at(3) == 4 && m.at(4) == 0 && m.at(63) == 0)
+    m.resize_(1, 3);
+    HT_ASSERT_TRUE(m.size() == 3 && m.at(0) == 1 && m.at(2) == 3)
+}
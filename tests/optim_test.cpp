@@ -0,0 +1,156 @@
+#include <sstream>
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+// f(x) = sum 100 (x_i+1 - x_i^2)^2 + (1 - x_i)^2
+double rosenbrock(const qs::MatrixXd& x, qs::MatrixXd& g)
+{
+    double fx{0};
+    g.fill_0_();
+    for (int i = 0; i + 1 < x.size(); ++i) {
+        const auto a{x.at(i + 1) - x.at(i) * x.at(i)};
+        const auto b{1 - x.at(i)};
+        fx += 100 * a * a + b * b;
+        g.at(i) += -400 * a * x.at(i) - 2 * b;
+        g.at(i + 1) += 200 * a;
+    }
+    return fx;
+}
+
+template<typename Solver>
+bool solves_rosenbrock(int max_iter, double c2)
+{
+    qs::MatrixXd x(10, 1);
+    for (int i = 0; i < x.size(); ++i) x.at(i) = i % 2 ? 1.0 : -1.2;
+    qs::optim::Options<double> opt;
+    opt.max_iter = max_iter;
+    opt.grad_tol = 1.0e-6;
+    opt.c2 = c2;
+    Solver solver(x.size(), opt);
+    auto result{solver.minimize(rosenbrock, x)};
+    if (result.status != qs::optim::Status::converged_grad) return false;
+    for (int i = 0; i < x.size(); ++i) {
+        if (std::abs(x.at(i) - 1) > 1.0e-4) return false;
+    }
+    return true;
+}
+
+HT_CASE(Optim, lbfgs_rosenbrock)
+{
+    HT_ASSERT_TRUE(solves_rosenbrock<qs::optim::LBFGS<double>>(200, 0.9))
+}
+
+HT_CASE(Optim, cg_rosenbrock)
+{
+    HT_ASSERT_TRUE(solves_rosenbrock<qs::optim::ConjugateGradient<double>>(1000, 0.1))
+}
+
+HT_CASE(Optim, gd_quadratic)
+{
+    // f(x) = x^TAx, minimum at 0
+    qs::Matrixd<3, 3> A;
+    A << 8, 2, 3,
+         2, 9, 5,
+         3, 5, 6;
+    qs::MatrixXd x(3, 1);
+    x << 4.0, 6.0, 9.0;
+    auto AAt{A + A.t()};
+
+    qs::optim::GradientDescent<double> solver(3);
+    auto result{solver.minimize([&] (const qs::MatrixXd& x, qs::MatrixXd& g) {
+        g = AAt * x;
+        return (x.t() * A * x).scalar();
+    }, x)};
+    HT_ASSERT_TRUE(result.status == qs::optim::Status::converged_grad)
+    HT_ASSERT_TRUE(x.norm2() < 1.0e-6)
+}
+
+HT_CASE(Optim, lbfgs_autodiff)
+{
+    qs::Matrixf<3, 3> A;
+    A << 8, 2, 3,
+         2, 9, 5,
+         3, 5, 6;
+    qs::MatrixXf x(3, 1);
+    x << 4.0f, 6.0f, 9.0f;
+
+    qs::ad::Tape<float> tape;
+    qs::optim::Options<float> opt;
+    opt.grad_tol = 1.0e-4f;
+    qs::optim::LBFGS<float> solver(3, opt);
+    auto result{solver.minimize([&] (const qs::MatrixXf& x, qs::MatrixXf& g) {
+        return tape.gradient([&] (const auto& x) { return x.t() * A * x; }, x, g);
+    }, x)};
+    HT_ASSERT_TRUE(result.status == qs::optim::Status::converged_grad)
+    HT_ASSERT_TRUE(result.iter < 20)
+}
+
+HT_CASE(Optim, lbfgs_restart)
+{
+    // f(x) = sum (i+1) x_i^2 / 2; the line search of the second iteration
+    // sees only increases, so it fails with a curvature pair in the history
+    qs::optim::Options<double> opt;
+    opt.f_tol = 1.0e-14;
+    opt.max_line_search = 5;
+    int evals{0};
+    // the window of failing evaluations starts out empty
+    int sabotage{-opt.max_line_search};
+    auto f{[&] (const qs::MatrixXd& x, qs::MatrixXd& g) {
+        double fx{0};
+        for (int i = 0; i < x.size(); ++i) {
+            fx += (i + 1) * x.at(i) * x.at(i) / 2;
+            g.at(i) = (i + 1) * x.at(i);
+        }
+        const bool bad{evals >= sabotage && evals < sabotage + opt.max_line_search};
+        ++evals;
+        return bad ? fx + 1.0e3 : fx;
+    }};
+    qs::MatrixXd x0(5, 1);
+    x0 << 1.0, -2.0, 3.0, -4.0, 5.0;
+
+    auto first{opt};
+    first.max_iter = 1;
+    auto x{x0};
+    sabotage = qs::optim::LBFGS<double>(x.size(), first).minimize(f, x).evals;
+
+    x = x0;
+    evals = 0;
+    qs::optim::LBFGS<double> solver(x.size(), opt);
+    qs::SolverTrace trace;
+    auto result{solver.minimize(f, x, trace)};
+    HT_ASSERT_TRUE(evals > sabotage + opt.max_line_search)
+    HT_ASSERT_TRUE(result.status == qs::optim::Status::converged_grad)
+    HT_ASSERT_TRUE(x.norm2() < 1.0e-5)
+    bool progress{true};
+    for (int i = 0; i < trace.size(); ++i) progress = progress && trace[i].dual > 0;
+    HT_ASSERT_TRUE(progress)
+}
+
+HT_CASE(Optim, trace)
+{
+    qs::MatrixXd x(10, 1);
+    for (int i = 0; i < x.size(); ++i) x.at(i) = i % 2 ? 1.0 : -1.2;
+    qs::optim::LBFGS<double> solver(x.size());
+    qs::SolverTrace trace;
+    int calls{0};
+    trace.on_iteration([&] (const qs::SolverTrace::Record& r) { calls += r.iter == calls; });
+    auto result{solver.minimize(rosenbrock, x, trace)};
+    HT_ASSERT_TRUE(result.status == qs::optim::Status::converged_grad)
+    HT_ASSERT_TRUE(trace.size() == result.iter && calls == result.iter)
+    HT_ASSERT_TRUE(trace.back().fx == result.fx && trace.back().primal == result.grad_norm)
+    HT_ASSERT_TRUE(trace.total(qs::Phase::line_search) > 0 && trace.total(qs::Phase::factor) == 0)
+    HT_ASSERT_TRUE(trace.back().wall >= trace[0].wall)
+
+    std::ostringstream csv;
+    trace.write_csv(csv);
+    const auto text{csv.str()};
+    HT_ASSERT_TRUE(text.rfind("iter,fx,primal,dual,factor,solve,prox,line_search,check,wall\n", 0) == 0)
+    HT_ASSERT_TRUE(std::count(text.begin(), text.end(), '\n') == result.iter + 1)
+
+    std::ostringstream json;
+    trace.write_json(json);
+    const auto objects{json.str()};
+    HT_ASSERT_TRUE(objects.front() == '[' && std::count(objects.begin(), objects.end(), '{') == result.iter)
+}
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <ctime>
+#include <stdexcept>
+#include <vector>
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+HT_CASE(ParallelSolve, every_task_once)
+{
+    qs::set_num_threads(4);
+    const int n{257};
+    std::vector<std::atomic<int>> runs(n);
+    std::vector<double> out(n);
+    std::atomic<int> nested{0};
+    auto result{qs::parallel_solve(n, [&] (int i, const qs::SolveContext& ctx) {
+        // kernels inside a task must not spawn threads of their own
+        if (qs::num_threads() != 1) nested.fetch_add(1);
+        // uneven cost, scratch from the worker arena
+        const int m{1 + (i * 37) % 64};
+        auto tmp{ctx.arena().alloc_0<double>(m)};
+        for (int k = 0; k < m; ++k) tmp[k] = k;
+        double s{0};
+        for (int k = 0; k < m; ++k) s += tmp[k];
+        out[i] = s;
+        if (ctx.index() == i && ctx.worker() >= 0 && ctx.worker() < 4) runs[i].fetch_add(1);
+    })};
+    HT_ASSERT_TRUE(result.done == n && result.skipped == 0)
+    HT_ASSERT_TRUE(nested.load() == 0 && qs::num_threads() == 4)
+    bool once{true};
+    for (int i = 0; i < n; ++i) {
+        const int m{1 + (i * 37) % 64};
+        once = once && runs[i].load() == 1 && out[i] == m * (m - 1) / 2.0;
+    }
+    HT_ASSERT_TRUE(once)
+}
+
+HT_CASE(ParallelSolve, cancel_and_deadline)
+{
+    qs::set_num_threads(3);
+    std::atomic<int> ran{0};
+    auto cancelled{qs::parallel_solve(1000, [&] (int i, const qs::SolveContext& ctx) {
+        ran.fetch_add(1);
+        if (i == 0) ctx.cancel();
+        while (ran.load() < 3 && !ctx.stop_requested()) std::this_thread::yield();
+    })};
+    HT_ASSERT_TRUE(cancelled.skipped > 0 && cancelled.done == ran.load() && cancelled.done + cancelled.skipped == 1000)
+
+    qs::SolveOptions opt;
+    opt.deadline = qs::StopToken::clock::now();
+    auto late{qs::parallel_solve(10, [] (int, const qs::SolveContext&) {}, opt)};
+    HT_ASSERT_TRUE(late.done == 0 && late.skipped == 10)
+
+    qs::StopToken external;
+    external.request_stop();
+    opt = qs::SolveOptions{};
+    opt.stop = &external;
+    auto stopped{qs::parallel_solve(10, [] (int, const qs::SolveContext&) {}, opt)};
+    HT_ASSERT_TRUE(stopped.done == 0)
+}
+
+HT_CASE(ParallelSolve, exception)
+{
+    bool caught{false};
+    try {
+        qs::parallel_solve(100, [] (int i, const qs::SolveContext&) {
+            if (i == 42) throw std::runtime_error("bad problem");
+        });
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    HT_ASSERT_TRUE(caught)
+}
+
+// f(x) = sum (x_i - k)^2
+double shifted(const qs::MatrixXd& x, qs::MatrixXd& g, double k)
+{
+    double fx{0};
+    for (int i = 0; i < x.size(); ++i) {
+        fx += (x.at(i) - k) * (x.at(i) - k);
+        g.at(i) = 2 * (x.at(i) - k);
+    }
+    return fx;
+}
+
+HT_CASE(ParallelSolve, task_budget)
+{
+    qs::set_num_threads(2);
+    std::vector<qs::optim::Status> status(8);
+    qs::SolveOptions opt;
+    opt.task_budget = std::chrono::milliseconds(5);
+    auto result{qs::parallel_solve(8, [&] (int i, const qs::SolveContext& ctx) {
+        qs::optim::Options<double> o;
+        o.stop = &ctx.token();
+        qs::optim::LBFGS<double> solver(4, o);
+        qs::MatrixXd x(4, 1);
+        x.fill_0_();
+        // odd problems straggle until their budget runs out
+        if (i % 2) {
+            while (!ctx.stop_requested()) std::this_thread::yield();
+        }
+        status[i] = solver.minimize([&] (const qs::MatrixXd& x, qs::MatrixXd& g) { return shifted(x, g, i + 1); }, x).status;
+    }, opt)};
+    HT_ASSERT_TRUE(result.done == 8)
+    bool ok{true};
+    for (int i = 0; i < 8; ++i) {
+        ok = ok && status[i] == (i % 2 ? qs::optim::Status::stopped : qs::optim::Status::converged_grad);
+    }
+    HT_ASSERT_TRUE(ok)
+}
+
+HT_CASE(ParallelSolve, idle_workers_sleep)
+{
+    // while one task straggles the other workers hold no work and must not
+    // burn CPU waiting for it
+    qs::set_num_threads(4);
+    const auto cpu0{std::clock()};
+    auto result{qs::parallel_solve(16, [&] (int i, const qs::SolveContext&) {
+        if (i == 0) std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    })};
+    const auto cpu{static_cast<double>(std::clock() - cpu0) / CLOCKS_PER_SEC};
+    HT_ASSERT_TRUE(result.done == 16)
+    HT_ASSERT_TRUE(cpu < 0.1)
+}
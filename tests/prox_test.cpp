@@ -0,0 +1,66 @@
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+bool near(const qs::MatrixXd& m, std::initializer_list<double> expected)
+{
+    int i{0};
+    for (auto v : expected) {
+        if (std::abs(m.at(i++) - v) > 1.0e-9) return false;
+    }
+    return i == m.size();
+}
+
+HT_CASE(Prox, elementwise)
+{
+    qs::MatrixXd x(5, 1);
+    x << -3.0, -0.5, 0.0, 0.5, 3.0;
+
+    auto l1{x};
+    qs::prox::soft_threshold_(l1, 1.0);
+    HT_ASSERT_TRUE(near(l1, {-2.0, 0.0, 0.0, 0.0, 2.0}))
+
+    auto en{x};
+    qs::prox::elastic_net_(en, 1.0, 1.0);
+    HT_ASSERT_TRUE(near(en, {-1.0, 0.0, 0.0, 0.0, 1.0}))
+
+    auto box{x};
+    qs::prox::box_(box, -1.0, 0.25);
+    HT_ASSERT_TRUE(near(box, {-1.0, -0.5, 0.0, 0.25, 0.25}))
+
+    auto pos{x};
+    qs::prox::nonneg_(pos);
+    HT_ASSERT_TRUE(near(pos, {0.0, 0.0, 0.0, 0.5, 3.0}))
+}
+
+HT_CASE(Prox, norm_balls)
+{
+    qs::MatrixXd x(2, 2);
+    x << 3.0, 4.0,
+         0.3, 0.4;
+
+    auto ball{x};
+    qs::prox::l2_ball_(ball, 1.0);
+    const auto s{1.0 / std::sqrt(25.25)};
+    HT_ASSERT_TRUE(near(ball, {3.0 * s, 4.0 * s, 0.3 * s, 0.4 * s}))
+
+    // rows are groups: ‖(3, 4)‖ = 5 shrinks to 4, ‖(0.3, 0.4)‖ = 0.5 vanishes
+    auto group{x};
+    qs::prox::group_lasso_(group, 1.0);
+    HT_ASSERT_TRUE(near(group, {2.4, 3.2, 0.0, 0.0}))
+}
+
+HT_CASE(Prox, simplex)
+{
+    qs::MatrixXd x(4, 1);
+    x << 0.5, 1.2, -0.3, 0.1;
+    qs::prox::simplex_(x);
+    // tau = 0.35 keeps the first two entries
+    HT_ASSERT_TRUE(near(x, {0.15, 0.85, 0.0, 0.0}))
+
+    qs::MatrixXd y(3, 1);
+    y << 0.2, 0.3, 0.1;
+    qs::prox::simplex_(y, 2.0);
+    HT_ASSERT_TRUE(near(y, {0.2 + 1.4 / 3, 0.3 + 1.4 / 3, 0.1 + 1.4 / 3}))
+}
@@ -0,0 +1,56 @@
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+template<typename A, typename B>
+bool qgemm_matches_reference(int m, int k, int n)
+{
+    qs::MatrixX<A> a(m, k);
+    qs::MatrixX<B> b(k, n);
+    // full range for 8 bit, 16 bit products are kept clear of int32 overflow
+    a.fill_uniform_(static_cast<A>(std::max<int>(std::numeric_limits<A>::min(), -4096)),
+                    static_cast<A>(std::min<int>(std::numeric_limits<A>::max(), 4096)));
+    b.fill_uniform_(static_cast<B>(std::max<int>(std::numeric_limits<B>::min(), -4096)),
+                    static_cast<B>(std::min<int>(std::numeric_limits<B>::max(), 4096)));
+
+    auto c{qs::qgemm(a, b)};
+    auto y{qs::qgemv(a, b.sub(0, 0, k, 1))};
+    for (int r = 0; r < m; ++r) {
+        for (int cc = 0; cc < n; ++cc) {
+            std::int32_t v{0};
+            for (int i = 0; i < k; ++i) v += static_cast<std::int32_t>(a.at(r, i)) * b.at(i, cc);
+            if (c.at(r, cc) != v) return false;
+            if (cc == 0 && y.at(r) != v) return false;
+        }
+    }
+    return true;
+}
+
+HT_CASE(Quantized, qgemm_exact)
+{
+    // odd sizes cover both the SIMD body and the scalar tail, extreme
+    // values would saturate a pmaddubsw based kernel
+    HT_ASSERT_TRUE((qgemm_matches_reference<std::uint8_t, std::int8_t>(7, 131, 5)))
+    HT_ASSERT_TRUE((qgemm_matches_reference<std::int8_t, std::int8_t>(7, 131, 5)))
+    HT_ASSERT_TRUE((qgemm_matches_reference<std::uint8_t, std::uint8_t>(7, 131, 5)))
+    HT_ASSERT_TRUE((qgemm_matches_reference<std::int8_t, std::uint8_t>(7, 131, 5)))
+    HT_ASSERT_TRUE((qgemm_matches_reference<std::int16_t, std::int16_t>(7, 67, 5)))
+}
+
+HT_CASE(Quantized, dequantized_product)
+{
+    qs::MatrixXf a(8, 64);
+    qs::MatrixXf b(64, 4);
+    a.fill_uniform_(-1.0f, 1.0f);
+    b.fill_uniform_(-1.0f, 1.0f);
+
+    auto qa{qs::quantize<std::int8_t>(a, true)};
+    auto qb{qs::quantize<std::int8_t>(b, false)};
+    auto c{qs::qgemm(qa, qb)};
+    auto expected{a * b};
+
+    float err{0};
+    for (int i = 0; i < c.size(); ++i) err = std::max(err, std::abs(c.at(i) - expected.at(i)));
+    HT_ASSERT_TRUE(err < 0.1f)
+}
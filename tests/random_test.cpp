@@ -0,0 +1,100 @@
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+HT_CASE(Random, philox_known_answer)
+{
+    // Random123 kat_vectors, philox4x32 10 rounds, zero counter and key
+    std::uint32_t w[4];
+    qs::Philox(0, 0).block(0, w);
+    HT_ASSERT_TRUE(w[0] == 0x6627e8d5u && w[1] == 0xe169c58du && w[2] == 0xbc57ac4cu && w[3] == 0x9b00dbd8u)
+}
+
+HT_CASE(Random, thread_count_independent)
+{
+    qs::MatrixXf a(600, 500);
+    qs::MatrixXf b(600, 500);
+    qs::set_num_threads(1);
+    a.fill_normal_(0.0f, 1.0f, qs::Philox(42));
+    qs::set_num_threads(7);
+    b.fill_normal_(0.0f, 1.0f, qs::Philox(42));
+
+    bool same{true};
+    for (int i = 0; i < a.size(); ++i) same = same && a.at(i) == b.at(i);
+    HT_ASSERT_TRUE(same)
+}
+
+HT_CASE(Random, reseed)
+{
+    qs::seed(7);
+    auto a{qs::Matrixd<4, 4>::rand()};
+    auto b{qs::Matrixd<4, 4>::rand()};
+    qs::seed(7);
+    auto c{qs::Matrixd<4, 4>::rand()};
+
+    bool a_eq_c{true};
+    bool a_eq_b{true};
+    for (int i = 0; i < a.size(); ++i) {
+        a_eq_c = a_eq_c && a.at(i) == c.at(i);
+        a_eq_b = a_eq_b && a.at(i) == b.at(i);
+    }
+    HT_ASSERT_TRUE(a_eq_c)
+    HT_ASSERT_FALSE(a_eq_b)
+}
+
+HT_CASE(Random, distributions)
+{
+    const int n{1 << 16};
+    qs::Array<double> normal(n);
+    qs::Array<float> uniform(n);
+    qs::Array<int> coin(n);
+    qs::Array<int> dice(n);
+    normal.fill_normal_(2.0, 3.0);
+    uniform.fill_uniform_(-1.0f, 1.0f);
+    coin.fill_bernoulli_(0.25);
+    dice.fill_uniform_(1, 6);
+
+    double mean{0};
+    double var{0};
+    for (int i = 0; i < n; ++i) mean += normal.at(i) / n;
+    for (int i = 0; i < n; ++i) var += (normal.at(i) - mean) * (normal.at(i) - mean) / n;
+    HT_ASSERT_TRUE(std::abs(mean - 2.0) < 0.05)
+    HT_ASSERT_TRUE(std::abs(std::sqrt(var) - 3.0) < 0.05)
+
+    bool in_range{true};
+    double umean{0};
+    double heads{0};
+    for (int i = 0; i < n; ++i) {
+        in_range = in_range && uniform.at(i) >= -1.0f && uniform.at(i) < 1.0f;
+        in_range = in_range && dice.at(i) >= 1 && dice.at(i) <= 6;
+        umean += uniform.at(i) / n;
+        heads += coin.at(i);
+    }
+    HT_ASSERT_TRUE(in_range)
+    HT_ASSERT_TRUE(std::abs(umean) < 0.02)
+    HT_ASSERT_TRUE(std::abs(heads / n - 0.25) < 0.01)
+}
+
+HT_CASE(Random, wide_integers)
+{
+    const int n{1001};
+    qs::Array<std::int64_t> wide(n);
+    wide.fill_uniform_(-3, 1000000000000);
+    qs::Array<std::int64_t> full(n);
+    full.fill_uniform_(std::numeric_limits<std::int64_t>::min(), std::numeric_limits<std::int64_t>::max());
+    qs::Array<int> full32(n);
+    full32.fill_uniform_(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+
+    bool in_range{true};
+    int negative{0};
+    int negative32{0};
+    for (int i = 0; i < n; ++i) {
+        in_range = in_range && wide.at(i) >= -3 && wide.at(i) <= 1000000000000;
+        negative += full.at(i) < 0;
+        negative32 += full32.at(i) < 0;
+    }
+    HT_ASSERT_TRUE(in_range)
+    HT_ASSERT_TRUE(negative > n / 3 && negative < 2 * n / 3)
+    HT_ASSERT_TRUE(negative32 > n / 3 && negative32 < 2 * n / 3)
+}
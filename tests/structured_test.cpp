@@ -0,0 +1,115 @@
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+bool near(const qs::MatrixXd& a, const qs::MatrixXd& b, double eps = 1.0e-9)
+{
+    if (a.row() != b.row() || a.col() != b.col()) return false;
+    for (int i = 0; i < a.size(); ++i) {
+        if (std::abs(a.at(i) - b.at(i)) > eps) return false;
+    }
+    return true;
+}
+
+HT_CASE(Structured, diagonal)
+{
+    qs::MatrixXd m(3, 2);
+    m << 1, 2,
+         3, 4,
+         5, 6;
+    qs::MatrixXd v(3, 1);
+    v << 2, -1, 0.5;
+    qs::DiagonalMatrix<double> d(v);
+
+    HT_ASSERT_TRUE(near(d * m, d.to_dense() * m))
+    HT_ASSERT_TRUE(near(m.t() * d, m.t() * d.to_dense()))
+    HT_ASSERT_TRUE(near(d.solve(m), d.to_dense().inv() * m))
+
+    qs::MatrixXd sq(3, 3);
+    sq.fill_uniform_(-1.0, 1.0);
+    HT_ASSERT_TRUE(near(sq + 0.5 * qs::DiagonalMatrix<double>::identity(3), sq + qs::MatrixXd::eye(3) * 0.5))
+}
+
+HT_CASE(Structured, triangular)
+{
+    qs::MatrixXd m(4, 4);
+    m.fill_uniform_(0.5, 1.5);
+    qs::MatrixXd b(4, 2);
+    b.fill_uniform_(-1.0, 1.0);
+
+    for (auto uplo : {qs::Uplo::lower, qs::Uplo::upper}) {
+        qs::TriangularView<double> tri(m, uplo);
+        auto dense{tri.to_dense()};
+        HT_ASSERT_TRUE(near(tri * b, dense * b))
+        HT_ASSERT_TRUE(near(dense * tri.solve(b), b, 1.0e-8))
+    }
+    auto unit{m.lower(true).to_dense()};
+    HT_ASSERT_TRUE(unit.at(2, 2) == 1.0 && unit.at(0, 3) == 0.0)
+}
+
+HT_CASE(Structured, symmetric_packed)
+{
+    qs::MatrixXd a(5, 5);
+    a.fill_uniform_(-1.0, 1.0);
+    auto spd{a.t() * a + qs::DiagonalMatrix<double>::identity(5)};
+    qs::SymmetricMatrix<double> s(spd);
+    qs::MatrixXd b(5, 3);
+    b.fill_uniform_(-1.0, 1.0);
+
+    HT_ASSERT_TRUE(s.size() == 15)
+    HT_ASSERT_TRUE(near(s.to_dense(), spd, 1.0e-12))
+    HT_ASSERT_TRUE(near(s * b, spd * b))
+    HT_ASSERT_TRUE(near(spd * s.solve(b), b, 1.0e-8))
+    HT_ASSERT_TRUE(near((s + qs::DiagonalMatrix<double>::identity(5)).to_dense(), spd + qs::MatrixXd::eye(5)))
+}
+
+HT_CASE(Structured, banded)
+{
+    // tridiagonal smoothing system, needs pivoting on the first row
+    const int n{50};
+    qs::BandedMatrix<double> t(n, 1, 1);
+    for (int i = 0; i < n; ++i) {
+        t.at(i, i) = i == 0 ? 0.0 : 4.0;
+        if (i > 0) t.at(i, i - 1) = -1.0;
+        if (i + 1 < n) t.at(i, i + 1) = -1.0;
+    }
+    qs::MatrixXd b(n, 2);
+    b.fill_uniform_(-1.0, 1.0);
+
+    auto dense{t.to_dense()};
+    HT_ASSERT_TRUE(near(t * b, dense * b))
+    HT_ASSERT_TRUE(near(dense * t.solve(b), b, 1.0e-8))
+
+    qs::MatrixXd m(6, 6);
+    m.fill_uniform_(-1.0, 1.0);
+    qs::BandedMatrix<double> wide(m, 2, 1);
+    qs::MatrixXd rhs(6, 1);
+    rhs.fill_uniform_(-1.0, 1.0);
+    HT_ASSERT_TRUE(near(wide.to_dense() * wide.solve(rhs), rhs, 1.0e-8))
+}
+
+HT_CASE(Structured, dense_mixing)
+{
+    qs::MatrixXd a(4, 4);
+    a.fill_uniform_(-1.0, 1.0);
+    qs::MatrixXd m(3, 4);
+    m.fill_uniform_(-1.0, 1.0);
+    qs::MatrixXd sq(4, 4);
+    sq.fill_uniform_(-1.0, 1.0);
+
+    // the view owns the temporary product
+    auto tri{(a * a).upper()};
+    const auto dense{tri.to_dense()};
+    HT_ASSERT_TRUE(near(m * tri, m * dense))
+    HT_ASSERT_TRUE(near(sq + tri, sq + dense) && near(tri + sq, sq + dense))
+    HT_ASSERT_TRUE(near(sq - tri, sq - dense) && near(tri - sq, dense - sq))
+
+    qs::SymmetricMatrix<double> s(a + a.t());
+    HT_ASSERT_TRUE(near(m * s, m * s.to_dense()))
+    HT_ASSERT_TRUE(near(sq - s, sq - s.to_dense()) && near(s - sq, s.to_dense() - sq))
+
+    qs::BandedMatrix<double> b(a, 1, 2);
+    HT_ASSERT_TRUE(near(m * b, m * b.to_dense()))
+    HT_ASSERT_TRUE(near(sq - b, sq - b.to_dense()) && near(b - sq, b.to_dense() - sq))
+}
@@ -0,0 +1,119 @@
+#include <cstdio>
+#include <fstream>
+#include "qs.hpp"
+#define HTEST_DEFINE_MAIN
+#include "htest.hpp"
+
+
+bool gemm_matches(int m, int k, int n)
+{
+    qs::MatrixXd a(m, k), b(k, n);
+    a.fill_uniform_(-1.0, 1.0, qs::Philox(3));
+    b.fill_uniform_(-1.0, 1.0, qs::Philox(3, 1));
+    const auto c{a * b};
+    for (int i = 0; i < m; ++i) {
+        for (int j = 0; j < n; ++j) {
+            double s{0};
+            for (int p = 0; p < k; ++p) s += a(i, p) * b(p, j);
+            if (std::abs(c(i, j) - s) > 1.0e-12) return false;
+        }
+    }
+    return true;
+}
+
+HT_CASE(Tuning, blocked_gemm)
+{
+    const auto saved{qs::tuning()};
+    for (int mr : {1, 2, 4}) {
+        auto t{saved};
+        t.gemm_mr = mr;
+        t.gemm_mc = 5;
+        t.gemm_kc = 7;
+        t.gemm_nc = 6;
+        qs::set_tuning(t);
+        HT_ASSERT_TRUE(gemm_matches(17, 13, 11))
+        HT_ASSERT_TRUE(gemm_matches(1, 1, 1))
+        // threaded row blocks
+        t.parallel_flops = 1;
+        qs::set_tuning(t);
+        qs::set_num_threads(3);
+        HT_ASSERT_TRUE(gemm_matches(23, 9, 14))
+    }
+
+    auto t{saved};
+    t.transpose_block = 4;
+    qs::set_tuning(t);
+    qs::MatrixXd m(19, 10);
+    m.fill_uniform_(-1.0, 1.0);
+    auto mt{m.t()};
+    bool ok{true};
+    for (int r = 0; r < m.row(); ++r) {
+        for (int c = 0; c < m.col(); ++c) ok = ok && mt(c, r) == m(r, c);
+    }
+    HT_ASSERT_TRUE(ok)
+    qs::set_tuning(saved);
+}
+
+HT_CASE(Tuning, profile)
+{
+    const std::string path{"qs_tuning_test.profile"};
+    const auto saved{qs::tuning()};
+    auto t{saved};
+    t.gemm_mc = 48;
+    t.gemm_mr = 2;
+    t.parallel_flops = 12345;
+    HT_ASSERT_TRUE(qs::save_tuning(path, t))
+    HT_ASSERT_TRUE(qs::load_tuning(path))
+    HT_ASSERT_TRUE(qs::tuning().gemm_mc == 48 && qs::tuning().gemm_mr == 2 && qs::tuning().parallel_flops == 12345)
+    qs::set_tuning(saved);
+
+    // unusable profiles leave the tuning alone
+    HT_ASSERT_FALSE(qs::load_tuning("qs_tuning_test.missing"))
+    {
+        std::ofstream os(path);
+        os << "version=1\nisa=" << qs::detail::isa_name() << "\ngemm_mr=3\n";
+    }
+    HT_ASSERT_FALSE(qs::load_tuning(path))
+    {
+        std::ofstream os(path);
+        os << "version=1\nisa=other\n";
+    }
+    HT_ASSERT_FALSE(qs::load_tuning(path))
+    {
+        std::ofstream os(path);
+        os << "version=1\ngemm_mc=lots\n";
+    }
+    HT_ASSERT_FALSE(qs::load_tuning(path))
+    {
+        // no machine keys, treated as another machine
+        std::ofstream os(path);
+        os << "version=1\ngemm_mc=48\n";
+    }
+    HT_ASSERT_FALSE(qs::load_tuning(path))
+    HT_ASSERT_TRUE(qs::tuning().gemm_mc == saved.gemm_mc)
+
+    qs::TuneOptions opt;
+    opt.size = 48;
+    opt.repeats = 1;
+    std::remove(path.c_str());
+    const auto tuned{qs::tune_once(path, opt)};
+    HT_ASSERT_TRUE(tuned.valid())
+    HT_ASSERT_TRUE(qs::load_tuning(path))
+    HT_ASSERT_TRUE(gemm_matches(31, 29, 37))
+    std::remove(path.c_str());
+    qs::set_tuning(saved);
+}
+
+HT_CASE(Tuning, deterministic)
+{
+    // only clear wins move off the defaults, two searches agree
+    const auto saved{qs::tuning()};
+    qs::TuneOptions opt;
+    opt.size = 96;
+    const auto a{qs::tune(opt)};
+    const auto b{qs::tune(opt)};
+    HT_ASSERT_TRUE(a.gemm_mr == b.gemm_mr && a.gemm_kc == b.gemm_kc && a.gemm_mc == b.gemm_mc)
+    HT_ASSERT_TRUE(a.gemm_nc == b.gemm_nc && a.transpose_block == b.transpose_block)
+    HT_ASSERT_TRUE(a.parallel_flops == b.parallel_flops)
+    qs::set_tuning(saved);
+}